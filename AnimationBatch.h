@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "SkeletalAnimator.h"
+#include "ThreadPool.h"
+
+/*
+ * A set of SkeletalAnimators updated together. Sampling, hierarchy composition and palette
+ * generation of each animator only touch that animator and its read-only clip, so the batch is
+ * split into ranges of characters that the pool's threads take and steal from each other.
+ */
+class AnimationBatch
+{
+public:
+	/*characters per range handed to a thread; small enough to steal, large enough to amortize*/
+	static constexpr int MIN_CHARACTERS_PER_RANGE = 4;
+
+	void Add(SkeletalAnimator* animator)
+	{
+		m_Animators.push_back(animator);
+	}
+
+	void Clear()
+	{
+		m_Animators.clear();
+	}
+
+	inline int GetCount() const { return static_cast<int>(m_Animators.size()); }
+
+	/**
+	 * @brief Advances every animator by dt and recomputes its palette. Returns once all are done;
+	 * GetFinalBoneMatrices then returns the new poses.
+	 */
+	void Update(ThreadPool& pool, float dt)
+	{
+		// About eight ranges per thread leaves room for stealing without much queue traffic.
+		int grain = std::max(MIN_CHARACTERS_PER_RANGE, GetCount() / (pool.getThreadCount() * 8));
+		pool.parallelFor(GetCount(), grain, [this, dt](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				m_Animators[i]->UpdateAnimation(dt);
+		});
+	}
+
+private:
+	std::vector<SkeletalAnimator*> m_Animators;
+};
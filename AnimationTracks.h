@@ -0,0 +1,707 @@
+#pragma once
+
+/* Key tracks of every bone of a clip, stored structure-of-arrays and sampled several bones at a time */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "KeyframeLookup.h"
+#include "KeyQuantization.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_TRACKS_SSE 1
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+struct KeyPosition
+{
+	glm::vec3 position;
+	float timeStamp;
+};
+
+struct KeyRotation
+{
+	glm::quat orientation;
+	float timeStamp;
+};
+
+struct KeyScale
+{
+	glm::vec3 scale;
+	float timeStamp;
+};
+
+/* A bone's local transform before composition into a matrix, the space poses are blended in */
+struct LocalPose
+{
+	glm::vec3 translation;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+/* Per-playback position in each of a track's key channels; owned by whoever samples the track */
+struct BoneCursor
+{
+	int position = 0;
+	int rotation = 0;
+	int scale = 0;
+};
+
+/* How a KeyChannel stores its key values */
+enum class KeyEncoding
+{
+	/*one float per component in x, y, z and w*/
+	Float,
+	/*three words per key in packed, fractions of the track's rangeMin/rangeStep (EncodeRange48)*/
+	Range48,
+	/*three words per key in packed, a rotation in EncodeSmallestThree form*/
+	SmallestThree48
+};
+
+/* One channel (positions, rotations or scales) of every track, concatenated */
+struct KeyChannel
+{
+	/*where each track's keys start in the arrays below, and how many it has*/
+	std::vector<int> firstKey;
+	std::vector<int> keyCount;
+
+	std::vector<float> timeStamps;
+	/*key components; w is only used by rotations*/
+	std::vector<float> x, y, z, w;
+
+	/*true while every track has the same key times (Mixamo bakes a key per frame), so one lookup serves all*/
+	bool sharedTimeStamps = true;
+
+	/*quantized keys and their per-track ranges, used instead of x/y/z/w once the clip is compressed*/
+	KeyEncoding encoding = KeyEncoding::Float;
+	std::vector<uint16_t> packed;
+	std::vector<glm::vec3> rangeMin, rangeStep;
+};
+
+/*
+ * Error tolerances for dropping keys in AnimationTracks::Compress; rotations in radians, positions
+ * and scales in clip units. Quantization adds up to about 1e-4 on top.
+ */
+struct TrackCompressionSettings
+{
+	float positionTolerance = 0.001f;
+	float rotationTolerance = 0.001f;
+	float scaleTolerance = 0.0001f;
+};
+
+struct TrackCompressionReport
+{
+	size_t bytesBefore = 0;
+	size_t bytesAfter = 0;
+	int keysBefore = 0;
+	int keysAfter = 0;
+
+	/*largest deviation from the source keys, measured at every source key time*/
+	float maxPositionError = 0.0f;
+	float maxRotationError = 0.0f;
+	float maxScaleError = 0.0f;
+};
+
+/*
+ * Immutable key data of a clip. Tracks are sampled in batches of TRACK_LANES: the key lookup
+ * runs per track, then interpolation (lerp for vectors, nlerp for quaternions) and the
+ * T * R * S matrix composition run with one track per SIMD lane.
+ */
+class AnimationTracks
+{
+public:
+	static constexpr int TRACK_LANES = 4;
+
+	/**
+	 * @brief Appends a track; every channel must have at least one key.
+	 * @return the index of the new track.
+	 */
+	int AddTrack(const std::string& name, const std::vector<KeyPosition>& positions,
+		const std::vector<KeyRotation>& rotations, const std::vector<KeyScale>& scales)
+	{
+		for (auto& key : positions)
+			AppendKey(m_Positions, key.timeStamp, key.position.x, key.position.y, key.position.z, 0.0f);
+		CloseTrack(m_Positions, positions.size());
+
+		for (auto& key : rotations)
+			AppendKey(m_Rotations, key.timeStamp, key.orientation.x, key.orientation.y,
+				key.orientation.z, key.orientation.w);
+		CloseTrack(m_Rotations, rotations.size());
+
+		for (auto& key : scales)
+			AppendKey(m_Scales, key.timeStamp, key.scale.x, key.scale.y, key.scale.z, 0.0f);
+		CloseTrack(m_Scales, scales.size());
+
+		m_Names.push_back(name);
+		return static_cast<int>(m_Names.size()) - 1;
+	}
+
+	/**
+	 * @brief Gets the index of the named track, or -1 if there is none.
+	 */
+	int FindTrack(const std::string& name) const
+	{
+		for (int i = 0; i < static_cast<int>(m_Names.size()); i++)
+		{
+			if (m_Names[i] == name)
+				return i;
+		}
+		return -1;
+	}
+
+	int GetTrackCount() const { return static_cast<int>(m_Names.size()); }
+	const std::string& GetTrackName(int track) const { return m_Names[track]; }
+
+	int GetKeyCount() const
+	{
+		return static_cast<int>(m_Positions.timeStamps.size() + m_Rotations.timeStamps.size() + m_Scales.timeStamps.size());
+	}
+
+	/**
+	 * @brief Gets the bytes held by the key channels.
+	 */
+	size_t GetMemoryUsage() const
+	{
+		return ChannelMemoryUsage(m_Positions) + ChannelMemoryUsage(m_Rotations) + ChannelMemoryUsage(m_Scales);
+	}
+
+	/**
+	 * @brief Drops every key that interpolating its neighbours reproduces within the settings'
+	 * tolerances, then quantizes rotations to 48-bit smallest-three and positions and scales to
+	 * 48 bits of a per-track range. Sampling decodes keys on the fly. Already compressed tracks
+	 * are left as they are.
+	 */
+	TrackCompressionReport Compress(const TrackCompressionSettings& settings)
+	{
+		TrackCompressionReport report;
+		report.bytesBefore = GetMemoryUsage();
+		report.keysBefore = GetKeyCount();
+
+		if (m_Rotations.encoding == KeyEncoding::Float)
+		{
+			m_Positions = CompressChannel(m_Positions, KeyEncoding::Range48,
+				settings.positionTolerance, report.maxPositionError);
+			m_Rotations = CompressChannel(m_Rotations, KeyEncoding::SmallestThree48,
+				settings.rotationTolerance, report.maxRotationError);
+			m_Scales = CompressChannel(m_Scales, KeyEncoding::Range48,
+				settings.scaleTolerance, report.maxScaleError);
+		}
+
+		report.bytesAfter = GetMemoryUsage();
+		report.keysAfter = GetKeyCount();
+		return report;
+	}
+
+	/**
+	 * @brief Samples every track at animationTime and writes its local T * R * S matrix.
+	 * @param cursors one per track; the caller's playback state, advanced by the lookups.
+	 * @param localTransforms receives one matrix per track.
+	 */
+	void SampleLocalTransforms(float animationTime, BoneCursor* cursors, glm::mat4* localTransforms) const
+	{
+		ForEachBatch(animationTime, cursors, [localTransforms](const LaneBatch& batch, int first, int lanes)
+		{
+			alignas(16) float matrices[16][TRACK_LANES];
+			ComposeLanes(batch, matrices);
+			StoreLanes(matrices, lanes, localTransforms + first);
+		});
+	}
+
+	/**
+	 * @brief Samples every track at animationTime without composing matrices, for callers that
+	 * blend poses first. Cursors as in SampleLocalTransforms.
+	 * @param localPoses receives one pose per track.
+	 */
+	void SampleLocalPoses(float animationTime, BoneCursor* cursors, LocalPose* localPoses) const
+	{
+		ForEachBatch(animationTime, cursors, [localPoses](const LaneBatch& batch, int first, int lanes)
+		{
+			const LaneKeys& p = batch.position;
+			const LaneKeys& r = batch.rotation;
+			const LaneKeys& s = batch.scale;
+			for (int lane = 0; lane < lanes; lane++)
+			{
+				glm::vec4 rotation = InterpolateKeys(
+					glm::vec4(r.from[0][lane], r.from[1][lane], r.from[2][lane], r.from[3][lane]),
+					glm::vec4(r.to[0][lane], r.to[1][lane], r.to[2][lane], r.to[3][lane]), r.factor[lane], true);
+
+				LocalPose& pose = localPoses[first + lane];
+				pose.translation = glm::mix(glm::vec3(p.from[0][lane], p.from[1][lane], p.from[2][lane]),
+					glm::vec3(p.to[0][lane], p.to[1][lane], p.to[2][lane]), p.factor[lane]);
+				pose.rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+				pose.scale = glm::mix(glm::vec3(s.from[0][lane], s.from[1][lane], s.from[2][lane]),
+					glm::vec3(s.to[0][lane], s.to[1][lane], s.to[2][lane]), s.factor[lane]);
+			}
+		});
+	}
+
+	/**
+	 * @brief Writes the tracks with a BinaryWriter (see AssetCache.h); Read restores them exactly,
+	 * compressed or not.
+	 */
+	template <typename Writer>
+	void Write(Writer& writer) const
+	{
+		for (const KeyChannel* channel : { &m_Positions, &m_Rotations, &m_Scales })
+		{
+			writer.writeVector(channel->firstKey);
+			writer.writeVector(channel->keyCount);
+			writer.writeVector(channel->timeStamps);
+			writer.writeVector(channel->x);
+			writer.writeVector(channel->y);
+			writer.writeVector(channel->z);
+			writer.writeVector(channel->w);
+			writer.write(channel->sharedTimeStamps);
+			writer.write(channel->encoding);
+			writer.writeVector(channel->packed);
+			writer.writeVector(channel->rangeMin);
+			writer.writeVector(channel->rangeStep);
+		}
+		writer.write(static_cast<uint64_t>(m_Names.size()));
+		for (auto& name : m_Names)
+			writer.writeString(name);
+	}
+
+	template <typename Reader>
+	void Read(Reader& reader)
+	{
+		for (KeyChannel* channel : { &m_Positions, &m_Rotations, &m_Scales })
+		{
+			reader.readVector(channel->firstKey);
+			reader.readVector(channel->keyCount);
+			reader.readVector(channel->timeStamps);
+			reader.readVector(channel->x);
+			reader.readVector(channel->y);
+			reader.readVector(channel->z);
+			reader.readVector(channel->w);
+			channel->sharedTimeStamps = reader.template read<bool>();
+			channel->encoding = reader.template read<KeyEncoding>();
+			reader.readVector(channel->packed);
+			reader.readVector(channel->rangeMin);
+			reader.readVector(channel->rangeStep);
+		}
+		uint64_t nameCount = reader.template read<uint64_t>();
+		m_Names.clear();
+		for (uint64_t i = 0; i < nameCount && !reader.failed(); i++)
+			m_Names.push_back(reader.readString());
+	}
+
+private:
+	/*the key starting the segment around the sample time, relative to the track's first key*/
+	struct KeySegment
+	{
+		int index = 0;
+		float factor = 0.0f;
+	};
+
+	/*the two keys around the sample time and the blend factor between them, one track per lane*/
+	struct alignas(16) LaneKeys
+	{
+		float from[4][TRACK_LANES];
+		float to[4][TRACK_LANES];
+		float factor[TRACK_LANES];
+	};
+
+	struct LaneBatch
+	{
+		LaneKeys position;
+		LaneKeys rotation;
+		LaneKeys scale;
+	};
+
+	/**
+	 * @brief Looks up and gathers the keys of every track at animationTime, TRACK_LANES tracks at a
+	 * time, and hands each batch to emit(batch, firstTrack, usedLanes).
+	 */
+	template <typename Emit>
+	void ForEachBatch(float animationTime, BoneCursor* cursors, Emit emit) const
+	{
+		const int trackCount = GetTrackCount();
+		if (trackCount == 0)
+			return;
+
+		// Channels whose tracks share key times are searched once, with the first track's cursor.
+		KeySegment sharedPosition, sharedRotation, sharedScale;
+		if (m_Positions.sharedTimeStamps)
+			sharedPosition = FindSegment(m_Positions, 0, animationTime, cursors[0].position);
+		if (m_Rotations.sharedTimeStamps)
+			sharedRotation = FindSegment(m_Rotations, 0, animationTime, cursors[0].rotation);
+		if (m_Scales.sharedTimeStamps)
+			sharedScale = FindSegment(m_Scales, 0, animationTime, cursors[0].scale);
+
+		for (int first = 0; first < trackCount; first += TRACK_LANES)
+		{
+			LaneBatch batch;
+			int lanes = std::min(TRACK_LANES, trackCount - first);
+			for (int lane = 0; lane < TRACK_LANES; lane++)
+			{
+				// Unused lanes of the last batch repeat its first track and are never stored.
+				int track = first + (lane < lanes ? lane : 0);
+				BoneCursor& cursor = cursors[track];
+				GatherKeys(m_Positions, track, m_Positions.sharedTimeStamps ? sharedPosition
+					: FindSegment(m_Positions, track, animationTime, cursor.position), batch.position, lane);
+				GatherKeys(m_Rotations, track, m_Rotations.sharedTimeStamps ? sharedRotation
+					: FindSegment(m_Rotations, track, animationTime, cursor.rotation), batch.rotation, lane);
+				GatherKeys(m_Scales, track, m_Scales.sharedTimeStamps ? sharedScale
+					: FindSegment(m_Scales, track, animationTime, cursor.scale), batch.scale, lane);
+			}
+			emit(batch, first, lanes);
+		}
+	}
+
+	static void AppendKey(KeyChannel& channel, float timeStamp, float x, float y, float z, float w)
+	{
+		channel.timeStamps.push_back(timeStamp);
+		channel.x.push_back(x);
+		channel.y.push_back(y);
+		channel.z.push_back(z);
+		channel.w.push_back(w);
+	}
+
+	static void CloseTrack(KeyChannel& channel, size_t keyCount)
+	{
+		int first = static_cast<int>(channel.timeStamps.size() - keyCount);
+		if (!channel.keyCount.empty())
+		{
+			channel.sharedTimeStamps = channel.sharedTimeStamps && channel.keyCount[0] == static_cast<int>(keyCount)
+				&& std::equal(channel.timeStamps.begin() + first, channel.timeStamps.end(), channel.timeStamps.begin());
+		}
+		channel.firstKey.push_back(first);
+		channel.keyCount.push_back(static_cast<int>(keyCount));
+	}
+
+	static KeySegment FindSegment(const KeyChannel& channel, int track, float animationTime, int& cursor)
+	{
+		KeySegment segment;
+		int count = channel.keyCount[track];
+		if (count > 1)
+		{
+			const float* timeStamps = &channel.timeStamps[channel.firstKey[track]];
+			segment.index = FindKeyIndex(timeStamps, count, animationTime, cursor);
+			segment.factor = GetKeyBlendFactor(timeStamps[segment.index], timeStamps[segment.index + 1], animationTime);
+		}
+		return segment;
+	}
+
+	static void GatherKeys(const KeyChannel& channel, int track, KeySegment segment, LaneKeys& keys, int lane)
+	{
+		int p0Index = channel.firstKey[track] + segment.index;
+		int p1Index = channel.keyCount[track] > 1 ? p0Index + 1 : p0Index;
+
+		if (channel.encoding != KeyEncoding::Float)
+		{
+			glm::vec4 from = DecodeKey(channel, track, p0Index);
+			glm::vec4 to = DecodeKey(channel, track, p1Index);
+			for (int component = 0; component < 4; component++)
+			{
+				keys.from[component][lane] = from[component];
+				keys.to[component][lane] = to[component];
+			}
+			keys.factor[lane] = segment.factor;
+			return;
+		}
+
+		keys.from[0][lane] = channel.x[p0Index];
+		keys.from[1][lane] = channel.y[p0Index];
+		keys.from[2][lane] = channel.z[p0Index];
+		keys.from[3][lane] = channel.w[p0Index];
+		keys.to[0][lane] = channel.x[p1Index];
+		keys.to[1][lane] = channel.y[p1Index];
+		keys.to[2][lane] = channel.z[p1Index];
+		keys.to[3][lane] = channel.w[p1Index];
+		keys.factor[lane] = segment.factor;
+	}
+
+	/**
+	 * @brief Gets a key as (x, y, z, w); w is 0 for positions and scales.
+	 */
+	static glm::vec4 DecodeKey(const KeyChannel& channel, int track, int key)
+	{
+		switch (channel.encoding)
+		{
+		case KeyEncoding::Range48:
+		{
+			glm::vec3 value = DecodeRange48(&channel.packed[key * 3], channel.rangeMin[track], channel.rangeStep[track]);
+			return glm::vec4(value, 0.0f);
+		}
+		case KeyEncoding::SmallestThree48:
+		{
+			glm::quat value = DecodeSmallestThree(&channel.packed[key * 3]);
+			return glm::vec4(value.x, value.y, value.z, value.w);
+		}
+		default:
+			return glm::vec4(channel.x[key], channel.y[key], channel.z[key], channel.w[key]);
+		}
+	}
+
+	/**
+	 * @brief Interpolates two keys the way sampling does: lerp, or nlerp along the short arc for rotations.
+	 */
+	static glm::vec4 InterpolateKeys(const glm::vec4& from, glm::vec4 to, float factor, bool rotation)
+	{
+		if (!rotation)
+			return glm::mix(from, to, factor);
+		if (glm::dot(from, to) < 0.0f)
+			to = -to;
+		glm::vec4 q = glm::mix(from, to, factor);
+		return q / glm::length(q);
+	}
+
+	/**
+	 * @brief Gets the distance between two keys, or the angle between two rotations.
+	 */
+	static float KeyError(const glm::vec4& a, glm::vec4 b, bool rotation)
+	{
+		if (!rotation)
+			return glm::length(glm::vec3(a) - glm::vec3(b));
+		// For unit quaternions |a - b| = 2 sin(angle / 4), which stays precise for small angles unlike acos.
+		if (glm::dot(a, b) < 0.0f)
+			b = -b;
+		float chord = std::min(glm::length(a - b) * 0.5f, 1.0f);
+		return 4.0f * std::asin(chord);
+	}
+
+	static size_t ChannelMemoryUsage(const KeyChannel& channel)
+	{
+		return (channel.firstKey.size() + channel.keyCount.size()) * sizeof(int)
+			+ (channel.timeStamps.size() + channel.x.size() + channel.y.size() + channel.z.size() + channel.w.size()) * sizeof(float)
+			+ channel.packed.size() * sizeof(uint16_t)
+			+ (channel.rangeMin.size() + channel.rangeStep.size()) * sizeof(glm::vec3);
+	}
+
+	/**
+	 * @brief Picks the keys of a track to keep so that linear interpolation between kept keys
+	 * stays within tolerance of every dropped key.
+	 * @return indices relative to the track's first key.
+	 */
+	static std::vector<int> ReduceKeys(const KeyChannel& channel, int track, float tolerance, bool rotation)
+	{
+		int first = channel.firstKey[track];
+		int count = channel.keyCount[track];
+		auto value = [&](int key) { return DecodeKey(channel, track, first + key); };
+		auto time = [&](int key) { return channel.timeStamps[first + key]; };
+
+		// A track that never leaves the tolerance around its first key needs only that key.
+		bool constant = true;
+		for (int key = 1; key < count && constant; key++)
+			constant = KeyError(value(0), value(key), rotation) <= tolerance;
+		if (constant)
+			return { 0 };
+
+		std::vector<int> kept = { 0 };
+		for (int key = 1; key < count - 1; key++)
+		{
+			// Keep this key if interpolating from the last kept key straight to the next one
+			// would move any key in between out of tolerance.
+			int anchor = kept.back();
+			for (int skipped = anchor + 1; skipped <= key; skipped++)
+			{
+				float factor = GetKeyBlendFactor(time(anchor), time(key + 1), time(skipped));
+				glm::vec4 estimate = InterpolateKeys(value(anchor), value(key + 1), factor, rotation);
+				if (KeyError(estimate, value(skipped), rotation) > tolerance)
+				{
+					kept.push_back(key);
+					break;
+				}
+			}
+		}
+		kept.push_back(count - 1);
+		return kept;
+	}
+
+	static KeyChannel CompressChannel(const KeyChannel& source, KeyEncoding encoding, float tolerance, float& maxError)
+	{
+		bool rotation = encoding == KeyEncoding::SmallestThree48;
+		KeyChannel result;
+		result.encoding = encoding;
+
+		for (int track = 0; track < static_cast<int>(source.firstKey.size()); track++)
+		{
+			int first = source.firstKey[track];
+			std::vector<int> kept = ReduceKeys(source, track, tolerance, rotation);
+
+			if (!rotation)
+			{
+				glm::vec3 low(std::numeric_limits<float>::max());
+				glm::vec3 high(std::numeric_limits<float>::lowest());
+				for (int key : kept)
+				{
+					glm::vec3 value(DecodeKey(source, track, first + key));
+					low = glm::min(low, value);
+					high = glm::max(high, value);
+				}
+				result.rangeMin.push_back(low);
+				result.rangeStep.push_back((high - low) / static_cast<float>(RANGE48_MAX));
+			}
+
+			for (int key : kept)
+			{
+				glm::vec4 value = DecodeKey(source, track, first + key);
+				uint16_t words[3];
+				if (rotation)
+					EncodeSmallestThree(glm::quat(value.w, value.x, value.y, value.z), words);
+				else
+					EncodeRange48(glm::vec3(value), result.rangeMin.back(), result.rangeStep.back(), words);
+				result.timeStamps.push_back(source.timeStamps[first + key]);
+				result.packed.insert(result.packed.end(), words, words + 3);
+			}
+			CloseTrack(result, kept.size());
+
+			// Measure what reduction and quantization together cost at every source key.
+			int cursor = 0;
+			for (int key = 0; key < source.keyCount[track]; key++)
+			{
+				KeySegment segment = FindSegment(result, track, source.timeStamps[first + key], cursor);
+				int p0Index = result.firstKey[track] + segment.index;
+				int p1Index = result.keyCount[track] > 1 ? p0Index + 1 : p0Index;
+				glm::vec4 sampled = InterpolateKeys(DecodeKey(result, track, p0Index),
+					DecodeKey(result, track, p1Index), segment.factor, rotation);
+				maxError = std::max(maxError, KeyError(sampled, DecodeKey(source, track, first + key), rotation));
+			}
+		}
+		return result;
+	}
+
+#ifdef ANIMATION_TRACKS_SSE
+	static __m128 Lerp(__m128 from, __m128 to, __m128 factor)
+	{
+		return _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), factor));
+	}
+
+	/**
+	 * @brief Interpolates and composes TRACK_LANES tracks into column-major matrix entries,
+	 * matrices[column * 4 + row][lane].
+	 */
+	static void ComposeLanes(const LaneBatch& batch, float (&matrices)[16][TRACK_LANES])
+	{
+		const LaneKeys& p = batch.position;
+		const LaneKeys& r = batch.rotation;
+		const LaneKeys& s = batch.scale;
+
+		__m128 pt = _mm_load_ps(p.factor);
+		__m128 tx = Lerp(_mm_load_ps(p.from[0]), _mm_load_ps(p.to[0]), pt);
+		__m128 ty = Lerp(_mm_load_ps(p.from[1]), _mm_load_ps(p.to[1]), pt);
+		__m128 tz = Lerp(_mm_load_ps(p.from[2]), _mm_load_ps(p.to[2]), pt);
+
+		__m128 st = _mm_load_ps(s.factor);
+		__m128 sx = Lerp(_mm_load_ps(s.from[0]), _mm_load_ps(s.to[0]), st);
+		__m128 sy = Lerp(_mm_load_ps(s.from[1]), _mm_load_ps(s.to[1]), st);
+		__m128 sz = Lerp(_mm_load_ps(s.from[2]), _mm_load_ps(s.to[2]), st);
+
+		// nlerp along the shorter arc: flip the second key when the quaternions point apart.
+		__m128 ax = _mm_load_ps(r.from[0]), ay = _mm_load_ps(r.from[1]);
+		__m128 az = _mm_load_ps(r.from[2]), aw = _mm_load_ps(r.from[3]);
+		__m128 bx = _mm_load_ps(r.to[0]), by = _mm_load_ps(r.to[1]);
+		__m128 bz = _mm_load_ps(r.to[2]), bw = _mm_load_ps(r.to[3]);
+		__m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+			_mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(cosine, _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+		bx = _mm_xor_ps(bx, flip);
+		by = _mm_xor_ps(by, flip);
+		bz = _mm_xor_ps(bz, flip);
+		bw = _mm_xor_ps(bw, flip);
+
+		__m128 rt = _mm_load_ps(r.factor);
+		__m128 qx = Lerp(ax, bx, rt), qy = Lerp(ay, by, rt), qz = Lerp(az, bz, rt), qw = Lerp(aw, bw, rt);
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+			_mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw))));
+		__m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), length);
+		qx = _mm_mul_ps(qx, inverseLength);
+		qy = _mm_mul_ps(qy, inverseLength);
+		qz = _mm_mul_ps(qz, inverseLength);
+		qw = _mm_mul_ps(qw, inverseLength);
+
+		// Rotation matrix of the unit quaternion, with columns scaled by S and T in the last column.
+		__m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+		__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+		_mm_store_ps(matrices[0], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx));
+		_mm_store_ps(matrices[1], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx));
+		_mm_store_ps(matrices[2], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx));
+		_mm_store_ps(matrices[3], _mm_setzero_ps());
+
+		_mm_store_ps(matrices[4], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy));
+		_mm_store_ps(matrices[5], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy));
+		_mm_store_ps(matrices[6], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy));
+		_mm_store_ps(matrices[7], _mm_setzero_ps());
+
+		_mm_store_ps(matrices[8], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz));
+		_mm_store_ps(matrices[9], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz));
+		_mm_store_ps(matrices[10], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz));
+		_mm_store_ps(matrices[11], _mm_setzero_ps());
+
+		_mm_store_ps(matrices[12], tx);
+		_mm_store_ps(matrices[13], ty);
+		_mm_store_ps(matrices[14], tz);
+		_mm_store_ps(matrices[15], one);
+	}
+
+	static void StoreLanes(const float (&matrices)[16][TRACK_LANES], int lanes, glm::mat4* out)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			// Transposing the four row vectors of a column yields that column for each lane.
+			__m128 c0 = _mm_load_ps(matrices[column * 4 + 0]);
+			__m128 c1 = _mm_load_ps(matrices[column * 4 + 1]);
+			__m128 c2 = _mm_load_ps(matrices[column * 4 + 2]);
+			__m128 c3 = _mm_load_ps(matrices[column * 4 + 3]);
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+			__m128 perLane[TRACK_LANES] = { c0, c1, c2, c3 };
+			for (int lane = 0; lane < lanes; lane++)
+				_mm_storeu_ps(&out[lane][column][0], perLane[lane]);
+		}
+	}
+#else
+	static void ComposeLanes(const LaneBatch& batch, float (&matrices)[16][TRACK_LANES])
+	{
+		const LaneKeys& p = batch.position;
+		const LaneKeys& r = batch.rotation;
+		const LaneKeys& s = batch.scale;
+
+		for (int lane = 0; lane < TRACK_LANES; lane++)
+		{
+			glm::vec3 translation = glm::mix(glm::vec3(p.from[0][lane], p.from[1][lane], p.from[2][lane]),
+				glm::vec3(p.to[0][lane], p.to[1][lane], p.to[2][lane]), p.factor[lane]);
+			glm::vec3 scale = glm::mix(glm::vec3(s.from[0][lane], s.from[1][lane], s.from[2][lane]),
+				glm::vec3(s.to[0][lane], s.to[1][lane], s.to[2][lane]), s.factor[lane]);
+
+			glm::quat from(r.from[3][lane], r.from[0][lane], r.from[1][lane], r.from[2][lane]);
+			glm::quat to(r.to[3][lane], r.to[0][lane], r.to[1][lane], r.to[2][lane]);
+			if (glm::dot(from, to) < 0.0f)
+				to = -to;
+			float t = r.factor[lane];
+			glm::quat q = glm::normalize(from * (1.0f - t) + to * t);
+
+			glm::mat4 m = glm::mat4_cast(q);
+			for (int column = 0; column < 3; column++)
+				for (int row = 0; row < 4; row++)
+					matrices[column * 4 + row][lane] = m[column][row] * scale[column];
+			matrices[12][lane] = translation.x;
+			matrices[13][lane] = translation.y;
+			matrices[14][lane] = translation.z;
+			matrices[15][lane] = 1.0f;
+		}
+	}
+
+	static void StoreLanes(const float (&matrices)[16][TRACK_LANES], int lanes, glm::mat4* out)
+	{
+		for (int lane = 0; lane < lanes; lane++)
+			for (int column = 0; column < 4; column++)
+				for (int row = 0; row < 4; row++)
+					out[lane][column][row] = matrices[column * 4 + row][lane];
+	}
+#endif
+
+	KeyChannel m_Positions;
+	KeyChannel m_Rotations;
+	KeyChannel m_Scales;
+	std::vector<std::string> m_Names;
+};
@@ -0,0 +1,304 @@
+#include "AssetCache.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char ASSET_CACHE_MAGIC[4] = { 'S', 'K', 'A', 'C' };
+const char* ASSET_CACHE_DIRECTORY = "cache";
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path& path)
+	: m_data(nullptr), m_size(0), m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr) {
+	m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+		return;
+	}
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr) {
+		return;
+	}
+	m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	m_size = m_data ? static_cast<size_t>(size.QuadPart) : 0;
+}
+
+MappedFile::~MappedFile() {
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+	}
+}
+#else
+MappedFile::MappedFile(const std::filesystem::path& path)
+	: m_data(nullptr), m_size(0) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED) {
+			m_data = static_cast<const char*>(mapping);
+			m_size = static_cast<size_t>(info.st_size);
+		}
+	}
+	// The mapping stays valid after the descriptor is closed.
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (m_data) {
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+}
+#endif
+
+uint64_t hashBytes(const void* data, size_t size) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t hashFile(const std::filesystem::path& path) {
+	MappedFile file(path);
+	if (!file.isOpen()) {
+		return 0;
+	}
+	return hashBytes(file.data(), file.size());
+}
+
+uint64_t hashCombine(uint64_t hash, uint64_t value) {
+	return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
+
+void BinaryWriter::writeString(const std::string& value) {
+	write(static_cast<uint64_t>(value.size()));
+	m_bytes.insert(m_bytes.end(), value.begin(), value.end());
+}
+
+bool BinaryWriter::saveTo(const std::filesystem::path& path) const {
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	// Each save writes a file of its own, so threads (or games) saving the same entry at once do
+	// not write into each other's; the last rename wins with a complete file.
+	static std::atomic<uint32_t> saves{ 0 };
+	std::filesystem::path temporary = path;
+	temporary += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "."
+		+ std::to_string(saves++) + ".tmp";
+	bool written;
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		written = static_cast<bool>(out.write(m_bytes.data(), m_bytes.size()));
+	}
+	if (written) {
+		std::filesystem::rename(temporary, path, error);
+	}
+	if (!written || error) {
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
+
+BinaryReader::BinaryReader(const char* data, size_t size)
+	: m_data(data), m_size(size), m_offset(0), m_failed(false) {
+}
+
+bool BinaryReader::take(void* out, size_t bytes) {
+	if (m_failed || bytes > m_size - m_offset) {
+		m_failed = true;
+		return false;
+	}
+	std::memcpy(out, m_data + m_offset, bytes);
+	m_offset += bytes;
+	return true;
+}
+
+std::string BinaryReader::readString() {
+	uint64_t length = read<uint64_t>();
+	if (m_failed || length > m_size - m_offset) {
+		m_failed = true;
+		return std::string();
+	}
+	std::string value(m_data + m_offset, length);
+	m_offset += length;
+	return value;
+}
+
+std::filesystem::path assetCachePath(const std::filesystem::path& source, const std::string& kind, uint64_t key) {
+	char keyText[17];
+	snprintf(keyText, sizeof(keyText), "%016llx", static_cast<unsigned long long>(key));
+	return std::filesystem::path(ASSET_CACHE_DIRECTORY) / (source.filename().string() + "." + keyText + "." + kind);
+}
+
+void beginAssetCache(BinaryWriter& writer, const std::string& kind, uint64_t key) {
+	writer.write(ASSET_CACHE_MAGIC);
+	writer.write(ASSET_CACHE_VERSION);
+	writer.writeString(kind);
+	writer.write(key);
+}
+
+bool openAssetCache(const MappedFile& file, const std::string& kind, uint64_t key, BinaryReader& reader) {
+	if (!file.isOpen()) {
+		return false;
+	}
+	reader = BinaryReader(file.data(), file.size());
+	char magic[4];
+	for (auto& c : magic) {
+		c = reader.read<char>();
+	}
+	bool matches = std::memcmp(magic, ASSET_CACHE_MAGIC, sizeof(magic)) == 0
+		&& reader.read<uint32_t>() == ASSET_CACHE_VERSION
+		&& reader.readString() == kind
+		&& reader.read<uint64_t>() == key;
+	return matches && !reader.failed();
+}
+
+void writeBoneInfoMap(BinaryWriter& writer, const std::unordered_map<std::string, BoneInfo>& boneInfoMap) {
+	writer.write(static_cast<uint64_t>(boneInfoMap.size()));
+	for (auto& entry : boneInfoMap) {
+		writer.writeString(entry.first);
+		writer.write(entry.second);
+	}
+}
+
+void readBoneInfoMap(BinaryReader& reader, std::unordered_map<std::string, BoneInfo>& boneInfoMap) {
+	uint64_t count = reader.read<uint64_t>();
+	boneInfoMap.clear();
+	for (uint64_t i = 0; i < count && !reader.failed(); i++) {
+		std::string name = reader.readString();
+		boneInfoMap[name] = reader.read<BoneInfo>();
+	}
+}
+
+/**
+ * @brief Checks that every index of a model read from the cache is in range, and that each node's
+ * children come after it, as in the depth-first order nodes are stored in; a damaged file could
+ * otherwise send Skeletal outside the arrays or round a loop.
+ */
+static bool s_indicesInRange(const ModelData& model) {
+	for (auto& mesh : model.meshes) {
+		for (int texture : mesh.textures) {
+			if (texture < 0 || static_cast<size_t>(texture) >= model.textures.size()) {
+				return false;
+			}
+		}
+	}
+	for (size_t i = 0; i < model.nodes.size(); i++) {
+		for (int mesh : model.nodes[i].meshes) {
+			if (mesh < 0 || static_cast<size_t>(mesh) >= model.meshes.size()) {
+				return false;
+			}
+		}
+		for (int child : model.nodes[i].children) {
+			if (child < 0 || static_cast<size_t>(child) <= i || static_cast<size_t>(child) >= model.nodes.size()) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool loadCachedModel(const std::filesystem::path& source, uint64_t key, ModelData& model) {
+	MappedFile file(assetCachePath(source, "model", key));
+	BinaryReader reader(nullptr, 0);
+	if (!openAssetCache(file, "model", key, reader)) {
+		return false;
+	}
+
+	model.meshes.resize(reader.read<uint64_t>());
+	for (auto& mesh : model.meshes) {
+		reader.readVector(mesh.vertices);
+		reader.readVector(mesh.faces);
+		reader.readVector(mesh.textures);
+	}
+
+	model.nodes.resize(reader.read<uint64_t>());
+	for (auto& node : model.nodes) {
+		node.transformation = reader.read<glm::mat4>();
+		reader.readVector(node.meshes);
+		reader.readVector(node.children);
+	}
+
+	model.textures.resize(reader.read<uint64_t>());
+	for (auto& texture : model.textures) {
+		texture.path = reader.readString();
+		texture.samplerName = reader.readString();
+		texture.arrayLayers.resize(reader.read<uint64_t>());
+		for (auto& layer : texture.arrayLayers) {
+			layer = reader.readString();
+		}
+		texture.layer = reader.read<int>();
+	}
+
+	readBoneInfoMap(reader, model.boneInfoMap);
+	model.boneCount = reader.read<int>();
+
+	return !reader.failed() && !model.nodes.empty() && s_indicesInRange(model);
+}
+
+void saveCachedModel(const std::filesystem::path& source, uint64_t key, const ModelData& model) {
+	BinaryWriter writer;
+	beginAssetCache(writer, "model", key);
+
+	writer.write(static_cast<uint64_t>(model.meshes.size()));
+	for (auto& mesh : model.meshes) {
+		writer.writeVector(mesh.vertices);
+		writer.writeVector(mesh.faces);
+		writer.writeVector(mesh.textures);
+	}
+
+	writer.write(static_cast<uint64_t>(model.nodes.size()));
+	for (auto& node : model.nodes) {
+		writer.write(node.transformation);
+		writer.writeVector(node.meshes);
+		writer.writeVector(node.children);
+	}
+
+	writer.write(static_cast<uint64_t>(model.textures.size()));
+	for (auto& texture : model.textures) {
+		writer.writeString(texture.path);
+		writer.writeString(texture.samplerName);
+		writer.write(static_cast<uint64_t>(texture.arrayLayers.size()));
+		for (auto& layer : texture.arrayLayers) {
+			writer.writeString(layer);
+		}
+		writer.write(texture.layer);
+	}
+
+	writeBoneInfoMap(writer, model.boneInfoMap);
+	writer.write(model.boneCount);
+
+	if (!writer.saveTo(assetCachePath(source, "model", key))) {
+		std::cout << "WARNING: could not write asset cache for " << source << std::endl;
+	}
+}
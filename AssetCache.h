@@ -0,0 +1,147 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "ModelData.h"
+
+/**
+ * @brief Bump whenever the layout of anything written to the cache changes; older files are ignored.
+ */
+constexpr uint32_t ASSET_CACHE_VERSION = 4;
+
+/**
+ * @brief A read-only memory mapping of a whole file.
+ */
+class MappedFile {
+private:
+	const char* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+
+public:
+	explicit MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool isOpen() const { return m_data != nullptr; }
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+};
+
+/**
+ * @brief Hashes a block of memory with 64-bit FNV-1a.
+ */
+uint64_t hashBytes(const void* data, size_t size);
+
+/**
+ * @brief Hashes the contents of a file with 64-bit FNV-1a; returns 0 if it cannot be read.
+ */
+uint64_t hashFile(const std::filesystem::path& path);
+
+/**
+ * @brief Mixes a value into a hash.
+ */
+uint64_t hashCombine(uint64_t hash, uint64_t value);
+
+/**
+ * @brief Appends trivially copyable values, vectors and strings to a byte buffer.
+ */
+class BinaryWriter {
+private:
+	std::vector<char> m_bytes;
+
+public:
+	template <typename T>
+	void write(const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written");
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		m_bytes.insert(m_bytes.end(), bytes, bytes + sizeof(T));
+	}
+
+	template <typename T>
+	void writeVector(const std::vector<T>& values) {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written");
+		write(static_cast<uint64_t>(values.size()));
+		const char* bytes = reinterpret_cast<const char*>(values.data());
+		m_bytes.insert(m_bytes.end(), bytes, bytes + values.size() * sizeof(T));
+	}
+
+	void writeString(const std::string& value);
+
+	/**
+	 * @brief Writes the buffer to a temporary file and renames it over path, so readers never see a partial file.
+	 */
+	bool saveTo(const std::filesystem::path& path) const;
+};
+
+/**
+ * @brief Reads back what a BinaryWriter wrote. Reading past the end sets failed() and yields zeroes.
+ */
+class BinaryReader {
+private:
+	const char* m_data;
+	size_t m_size;
+	size_t m_offset;
+	bool m_failed;
+
+	bool take(void* out, size_t bytes);
+
+public:
+	BinaryReader(const char* data, size_t size);
+
+	template <typename T>
+	T read() {
+		T value{};
+		take(&value, sizeof(T));
+		return value;
+	}
+
+	template <typename T>
+	void readVector(std::vector<T>& values) {
+		uint64_t count = read<uint64_t>();
+		if (m_failed || count > (m_size - m_offset) / sizeof(T)) {
+			m_failed = true;
+			values.clear();
+			return;
+		}
+		values.resize(count);
+		take(values.data(), count * sizeof(T));
+	}
+
+	std::string readString();
+
+	bool failed() const { return m_failed; }
+};
+
+/**
+ * @brief Gets the cache file for a source asset: cache/<file name>.<key>.<kind>.
+ */
+std::filesystem::path assetCachePath(const std::filesystem::path& source, const std::string& kind, uint64_t key);
+
+/**
+ * @brief Opens a cache file and checks its header against kind and key.
+ * @return true if the header matches; the reader is then positioned after it.
+ */
+bool openAssetCache(const MappedFile& file, const std::string& kind, uint64_t key, BinaryReader& reader);
+
+/**
+ * @brief Starts a cache file for the given kind and key.
+ */
+void beginAssetCache(BinaryWriter& writer, const std::string& kind, uint64_t key);
+
+/**
+ * @brief Loads a model previously stored by saveCachedModel under the same key. Returns false,
+ * for the caller to import the model again, if there is none or the file is damaged.
+ */
+bool loadCachedModel(const std::filesystem::path& source, uint64_t key, ModelData& model);
+void saveCachedModel(const std::filesystem::path& source, uint64_t key, const ModelData& model);
+
+void writeBoneInfoMap(BinaryWriter& writer, const std::unordered_map<std::string, BoneInfo>& boneInfoMap);
+void readBoneInfoMap(BinaryReader& reader, std::unordered_map<std::string, BoneInfo>& boneInfoMap);
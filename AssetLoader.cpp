@@ -0,0 +1,97 @@
+#include "AssetLoader.h"
+#include <exception>
+#include <iostream>
+
+ModelHandle::ModelHandle()
+	: m_root(std::vector<Mesh3D>{}) {
+}
+
+void ModelHandle::setPlaceholder(Object3D&& placeholder) {
+	if (isReady()) {
+		return;
+	}
+	if (m_root.numberOfChildren() > 0) {
+		m_root.getChild(0) = std::move(placeholder);
+	}
+	else {
+		m_root.addChild(std::move(placeholder));
+	}
+}
+
+void ModelHandle::upload(std::unique_ptr<Imported> imported) {
+	m_model = std::make_unique<Skeletal>(std::move(imported->model));
+	m_clips = std::move(imported->clips);
+	if (m_root.numberOfChildren() > 0) {
+		m_root.getChild(0) = m_model->takeRoot();
+	}
+	else {
+		m_root.addChild(m_model->takeRoot());
+	}
+}
+
+AssetLoader::AssetLoader()
+	: m_start(std::chrono::steady_clock::now()) {
+}
+
+ModelHandle& AssetLoader::loadModel(const std::string& path, bool flipTextureCoords,
+	const std::vector<std::string>& animationPaths, int boneInfluences) {
+	m_handles.push_back(std::unique_ptr<ModelHandle>(new ModelHandle()));
+	ModelHandle& handle = *m_handles.back();
+	handle.m_path = path;
+
+	// One thread per model: imports are few, long, and mostly independent of each other.
+	handle.m_pending = std::async(std::launch::async, [=]() {
+		auto imported = std::make_unique<ModelHandle::Imported>();
+		imported->model = Skeletal::importModel(path, flipTextureCoords, boneInfluences);
+		TrackCompressionSettings compression;
+		for (auto& animationPath : animationPaths) {
+			// every file's clips pose the first file's skeleton, so any two of them can be blended
+			imported->clips.push_back(std::make_unique<SkeletalAnimationLibrary>(animationPath,
+				imported->model.model.boneInfoMap, imported->model.model.boneCount,
+				imported->clips.empty() ? nullptr : imported->clips.front().get(), &compression));
+		}
+		return imported;
+	});
+	m_pending++;
+	return handle;
+}
+
+int AssetLoader::update() {
+	int finished = 0;
+	for (auto& handle : m_handles) {
+		if (handle->m_pending.valid()
+			&& handle->m_pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			// Counted as done before anything can throw, so a failed model never keeps the loader pending.
+			finished++;
+			m_pending--;
+			try {
+				handle->upload(handle->m_pending.get());
+			}
+			catch (const std::exception& error) {
+				handle->m_model.reset();
+				handle->m_failed = true;
+				m_failed++;
+				std::cout << "ERROR: could not load model " << handle->m_path << ": " << error.what() << std::endl;
+			}
+		}
+	}
+	if (finished > 0 && m_pending == 0) {
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+		std::cout << "All " << m_handles.size() << (m_failed > 0 ? " models finished loading " : " models loaded ")
+			<< elapsed << " ms after the loader started";
+		if (m_failed > 0) {
+			std::cout << "; " << m_failed << " failed and kept their placeholders";
+		}
+		std::cout << "\n";
+	}
+	return finished;
+}
+
+void AssetLoader::finish() {
+	for (auto& handle : m_handles) {
+		if (handle->m_pending.valid()) {
+			handle->m_pending.wait();
+		}
+	}
+	update();
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Object3D.h"
+#include "Skeletal.h"
+#include "SkeletalAnimationLibrary.h"
+
+/**
+ * @brief A model requested from an AssetLoader. Its root object exists from the start, so the
+ * scene can place, move and draw it right away: it holds a placeholder until the model is
+ * uploaded, then the model's hierarchy as its only child.
+ */
+class ModelHandle {
+private:
+	friend class AssetLoader;
+
+	// What a worker thread hands back: everything but the OpenGL objects.
+	struct Imported {
+		ImportedModel model;
+		std::vector<std::unique_ptr<SkeletalAnimationLibrary>> clips;
+	};
+
+	std::string m_path;
+	std::future<std::unique_ptr<Imported>> m_pending;
+	// the import or the upload threw; the root keeps its placeholder for good
+	bool m_failed = false;
+	std::unique_ptr<Skeletal> m_model;
+	std::vector<std::unique_ptr<SkeletalAnimationLibrary>> m_clips;
+	Object3D m_root;
+
+	ModelHandle();
+
+	/**
+	 * @brief Uploads the model, replacing the placeholder.
+	 */
+	void upload(std::unique_ptr<Imported> imported);
+
+public:
+	ModelHandle(const ModelHandle&) = delete;
+	ModelHandle& operator=(const ModelHandle&) = delete;
+
+	bool isReady() const { return m_model != nullptr; }
+	bool hasFailed() const { return m_failed; }
+
+	Object3D& getRoot() { return m_root; }
+
+	/**
+	 * @brief Gives the root something to draw until the model is ready; ignored after that.
+	 */
+	void setPlaceholder(Object3D&& placeholder);
+
+	// Only once ready; the model's hierarchy has been moved into the root.
+	Skeletal& getModel() { return *m_model; }
+	// the clips of the loadModel call's animationPaths[file]
+	const SkeletalAnimationLibrary& getClips(size_t file) const { return *m_clips[file]; }
+};
+
+/**
+ * @brief Loads models and their animation clips in the background. Each model is imported (or
+ * read from the asset cache), built and has its textures decoded on a thread of its own; only
+ * the upload to OpenGL is left for update, on the thread owning the context.
+ */
+class AssetLoader {
+private:
+	std::vector<std::unique_ptr<ModelHandle>> m_handles;
+	size_t m_pending = 0;
+	size_t m_failed = 0;
+	std::chrono::steady_clock::time_point m_start;
+
+public:
+	AssetLoader();
+
+	/**
+	 * @brief Starts loading a model and the clips of each animation file, which may add bones to
+	 * the model; clips are compressed with the default TrackCompressionSettings. Needs no OpenGL
+	 * context. The handle lives as long as the loader.
+	 */
+	ModelHandle& loadModel(const std::string& path, bool flipTextureCoords,
+		const std::vector<std::string>& animationPaths = {}, int boneInfluences = DEFAULT_BONE_INFLUENCES);
+
+	/**
+	 * @brief Uploads the models that finished loading since the last call; call on the context's
+	 * thread, e.g. once per frame. A model whose import or upload throws is logged and marked
+	 * failed (see ModelHandle::hasFailed), and keeps its placeholder.
+	 * @return the number of models that finished, uploaded or failed.
+	 */
+	int update();
+
+	/**
+	 * @brief Waits for every model and uploads it.
+	 */
+	void finish();
+
+	size_t getPendingCount() const { return m_pending; }
+};
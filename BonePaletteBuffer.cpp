@@ -0,0 +1,75 @@
+#include "BonePaletteBuffer.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+constexpr size_t PALETTE_BYTES = BONE_PALETTE_MAX_BONES * sizeof(glm::mat4);
+
+BonePaletteBuffer::BonePaletteBuffer(int palettesPerFrame, int framesInFlight)
+	: m_palettesPerFrame(palettesPerFrame), m_frameCount(framesInFlight), m_frame(0), m_used(0),
+	m_fences(framesInFlight, nullptr) {
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_paletteStride = (PALETTE_BYTES + alignment - 1) / alignment * alignment;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, m_paletteStride * m_palettesPerFrame * m_frameCount, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+BonePaletteBuffer::~BonePaletteBuffer() {
+	for (auto fence : m_fences) {
+		if (fence) {
+			glDeleteSync(fence);
+		}
+	}
+	glDeleteBuffers(1, &m_buffer);
+}
+
+void BonePaletteBuffer::beginFrame() {
+	m_frame = (m_frame + 1) % m_frameCount;
+	m_used = 0;
+
+	GLsync& fence = m_fences[m_frame];
+	if (fence) {
+		// Flush on the first wait, so the fence is sure to be submitted and signal eventually.
+		GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) {
+			flags = 0;
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
+
+size_t BonePaletteBuffer::upload(const glm::mat4* matrices, int count) {
+	if (m_used == m_palettesPerFrame) {
+		throw std::runtime_error("BonePaletteBuffer: more palettes in a frame than it was created for");
+	}
+	size_t offset = (static_cast<size_t>(m_frame) * m_palettesPerFrame + m_used) * m_paletteStride;
+	m_used++;
+
+	size_t bytes = std::min(count, BONE_PALETTE_MAX_BONES) * sizeof(glm::mat4);
+	if (bytes == 0) {
+		return offset;
+	}
+	// The fence in beginFrame already guarantees the GPU is done with this range, so skip the driver's own sync.
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	void* destination = glMapBufferRange(GL_UNIFORM_BUFFER, offset, bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (destination) {
+		std::memcpy(destination, matrices, bytes);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	return offset;
+}
+
+void BonePaletteBuffer::bind(size_t offset) const {
+	glBindBufferRange(GL_UNIFORM_BUFFER, BONE_PALETTE_BINDING, m_buffer, offset, PALETTE_BYTES);
+}
+
+void BonePaletteBuffer::endFrame() {
+	m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
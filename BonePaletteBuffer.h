@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+/**
+ * @brief Uniform block binding point of the BonePalette block in skeletal.vert and shadow_map.vert.
+ */
+constexpr uint32_t BONE_PALETTE_BINDING = 0;
+
+/**
+ * @brief Size of the finalBonesMatrices array in the BonePalette block (MAX_BONES in the shaders).
+ */
+constexpr int BONE_PALETTE_MAX_BONES = 100;
+
+/**
+ * @brief A uniform buffer holding every character's bone palette for the last few frames.
+ * Each frame writes into its own region of a ring; a fence per region makes sure the GPU is done
+ * reading a region before the CPU overwrites it, so uploads never wait on draws in flight.
+ * A palette is uploaded once per frame and then bound for each pass that draws the character.
+ */
+class BonePaletteBuffer {
+private:
+	uint32_t m_buffer;
+	// bytes between consecutive palettes, rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	size_t m_paletteStride;
+	int m_palettesPerFrame;
+	int m_frameCount;
+	int m_frame;
+	int m_used;
+	std::vector<GLsync> m_fences;
+
+public:
+	/**
+	 * @brief Allocates room for palettesPerFrame palettes in each of framesInFlight frames.
+	 */
+	BonePaletteBuffer(int palettesPerFrame, int framesInFlight = 3);
+	~BonePaletteBuffer();
+	BonePaletteBuffer(const BonePaletteBuffer&) = delete;
+	BonePaletteBuffer& operator=(const BonePaletteBuffer&) = delete;
+
+	/**
+	 * @brief Moves to the next region of the ring, waiting for the GPU to finish the frame that
+	 * last used it (normally long done).
+	 */
+	void beginFrame();
+
+	/**
+	 * @brief Copies a palette into this frame's region; at most BONE_PALETTE_MAX_BONES matrices
+	 * are used.
+	 * @return the byte offset to pass to bind.
+	 */
+	size_t upload(const glm::mat4* matrices, int count);
+
+	/**
+	 * @brief Binds an uploaded palette to the BonePalette block for the following draws.
+	 */
+	void bind(size_t offset) const;
+
+	/**
+	 * @brief Marks the end of the draws that read this frame's region.
+	 */
+	void endFrame();
+};
@@ -0,0 +1,167 @@
+#include "GeometryPool.h"
+#include <algorithm>
+#include "Mesh3D.h"
+
+// Room for the whole bundled scene in one block per layout: 3-4 MB of vertices and 1-2 MB of indices.
+constexpr uint32_t BLOCK_VERTICES = 1 << 17;
+constexpr uint32_t BLOCK_INDICES = 1 << 19;
+
+GeometryPool::~GeometryPool() {
+	for (auto& block : m_blocks) {
+		glDeleteVertexArrays(1, &block.vao);
+		glDeleteBuffers(1, &block.vertexBuffer);
+		glDeleteBuffers(1, &block.indexBuffer);
+	}
+}
+
+GeometryPool& GeometryPool::shared() {
+	// Never destroyed: at exit the context, and every buffer with it, may already be gone.
+	static GeometryPool* pool = new GeometryPool();
+	return *pool;
+}
+
+static size_t s_indexSize(GLenum indexType) {
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+GeometryPool::Block& GeometryPool::createBlock(VertexLayout layout, GLenum indexType, uint32_t vertexCapacity,
+	uint32_t indexCapacity) {
+	Block block{ layout, indexType, 0, 0, 0, vertexCapacity, indexCapacity, 0, 0 };
+
+	// Allocate the vertex and element buffers; meshes are copied into them later.
+	glGenBuffers(1, &block.vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, block.vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexCapacity) * vertexStride(layout), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glGenBuffers(1, &block.indexBuffer);
+	m_blocks.push_back(block);
+
+	// Generate a vertex array object on the GPU, and bind it so it records the buffers.
+	Block& added = m_blocks.back();
+	glGenVertexArrays(1, &added.vao);
+	glBindVertexArray(added.vao);
+	setUpVertexArray(static_cast<uint32_t>(m_blocks.size() - 1));
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indexCapacity) * s_indexSize(indexType), nullptr,
+		GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	return added;
+}
+
+void GeometryPool::setUpVertexArray(uint32_t block) const {
+	glBindBuffer(GL_ARRAY_BUFFER, m_blocks[block].vertexBuffer);
+	VertexLayout layout = m_blocks[block].layout;
+	GLsizei stride = static_cast<GLsizei>(vertexStride(layout));
+
+	// Attribute 0 is position: 3 contiguous floats (x/y/z). The layouts share their first 24 bytes.
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(StaticVertex, position));
+	glEnableVertexAttribArray(0);
+
+	// Attribute 1 is the normal, octahedral-encoded in 2 snorm16; the shaders decode it.
+	glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(StaticVertex, normal));
+	glEnableVertexAttribArray(1);
+
+	// Attribute 2 is texture coordinates (u, v): 2 half floats.
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(StaticVertex, texCoords));
+	glEnableVertexAttribArray(2);
+
+	// add: tangent vector, encoded like the normal
+	glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(StaticVertex, tangent));
+	glEnableVertexAttribArray(3);
+
+	if (layout == VertexLayout::Skinned) {
+		// bones id, one byte each
+		glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(SkinnedVertex, boneIds));
+		glEnableVertexAttribArray(4);
+
+		// weights, unorm8
+		glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(SkinnedVertex, weights));
+		glEnableVertexAttribArray(5);
+	}
+	else if (layout == VertexLayout::Skinned8) {
+		// the four heaviest influences, read like SkinnedVertex's
+		glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(SkinnedVertex8, boneIds));
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(SkinnedVertex8, weights));
+		glEnableVertexAttribArray(5);
+
+		// the other four
+		glVertexAttribIPointer(10, 4, GL_UNSIGNED_BYTE, stride, (void*)(offsetof(SkinnedVertex8, boneIds) + 4));
+		glEnableVertexAttribArray(10);
+		glVertexAttribPointer(11, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(offsetof(SkinnedVertex8, weights) + 4));
+		glEnableVertexAttribArray(11);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// The element buffer binding is part of the vertex array's state.
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_blocks[block].indexBuffer);
+}
+
+void GeometryPool::bindVertexArray(const GeometryRange& geometry) const {
+	bindVertexArray(geometry.block, geometry.vao);
+}
+
+void GeometryPool::bindVertexArray(uint32_t block, uint32_t vao) const {
+	if (m_blocks[block].layout != VertexLayout::Skinned8) {
+		// Arrays without the extra influences read the current value of attribute 11, a context
+		// state rather than part of the vertex array, which a draw with the attribute's array
+		// enabled leaves undefined. It must say "no weight" for the shaders' early out.
+		glVertexAttrib4f(11, 0.0f, 0.0f, 0.0f, 0.0f);
+	}
+	glBindVertexArray(vao);
+}
+
+GeometryRange GeometryPool::add(const Vertex3D* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+	VertexLayout layout = chooseVertexLayout(vertices, vertexCount);
+	size_t stride = vertexStride(layout);
+	m_packed.resize(vertexCount * stride);
+	packVertices(vertices, vertexCount, layout, m_packed.data());
+
+	// Indices are local to the mesh, so 16 bits address up to 65536 vertices.
+	GLenum indexType = vertexCount <= (1u << 16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	size_t indexSize = s_indexSize(indexType);
+	const void* indexData = indices;
+	if (indexType == GL_UNSIGNED_SHORT) {
+		m_shortIndices.assign(indices, indices + indexCount);
+		indexData = m_shortIndices.data();
+	}
+
+	// Fill the newest block of the layout and index type; older blocks are left with whatever room they have.
+	Block* block = nullptr;
+	for (auto it = m_blocks.rbegin(); it != m_blocks.rend(); ++it) {
+		if (it->layout == layout && it->indexType == indexType) {
+			block = &*it;
+			break;
+		}
+	}
+	if (block == nullptr || block->vertexCount + vertexCount > block->vertexCapacity
+		|| block->indexCount + indexCount > block->indexCapacity) {
+		block = &createBlock(layout, indexType, std::max(vertexCount, BLOCK_VERTICES), std::max(indexCount, BLOCK_INDICES));
+	}
+
+	GeometryRange range{ static_cast<uint32_t>(block - m_blocks.data()), block->vao,
+		static_cast<int32_t>(block->vertexCount), block->indexCount, indexCount, indexType };
+
+	glBindBuffer(GL_ARRAY_BUFFER, block->vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(block->vertexCount) * stride,
+		static_cast<GLsizeiptr>(m_packed.size()), m_packed.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// Bind through the vertex array, so the upload cannot disturb another array's element buffer.
+	glBindVertexArray(block->vao);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(block->indexCount) * indexSize,
+		static_cast<GLsizeiptr>(indexCount) * indexSize, indexData);
+	glBindVertexArray(0);
+
+	block->vertexCount += vertexCount;
+	block->indexCount += indexCount;
+	m_vertexCounts[static_cast<int>(layout)] += vertexCount;
+	m_vertexBytes += m_packed.size();
+	m_indexBytes += indexCount * indexSize;
+	m_shortIndexMeshes += indexType == GL_UNSIGNED_SHORT ? 1 : 0;
+	m_meshes++;
+	return range;
+}
+
+size_t GeometryPool::getUnpackedVertexBytes() const {
+	return (static_cast<size_t>(m_vertexCounts[0]) + m_vertexCounts[1] + m_vertexCounts[2]) * sizeof(Vertex3D);
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include "VertexFormat.h"
+
+/**
+ * @brief Where a mesh's geometry lives in a GeometryPool.
+ */
+struct GeometryRange {
+	// block holding the mesh, and its vertex array; shared by every mesh in that block
+	uint32_t block;
+	uint32_t vao;
+	// added to every index of the mesh, see glDrawElementsBaseVertex
+	int32_t baseVertex;
+	// offset of the mesh's first index in the block's element buffer, in indices
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, the block's index type
+	GLenum indexType;
+
+	/**
+	 * @brief The firstIndex offset in bytes, as glDrawElements takes it.
+	 */
+	const void* indexOffset() const {
+		return (const void*)(static_cast<size_t>(firstIndex) * (indexType == GL_UNSIGNED_SHORT ? 2 : 4));
+	}
+};
+
+/**
+ * @brief Holds the vertices and indices of every Mesh3D in a few large buffers instead of one
+ * pair of small buffers per mesh. Meshes are packed one after another into blocks; each block
+ * holds one VertexLayout and one index type, and has a vertex buffer, an element buffer and one
+ * vertex array describing that layout, so meshes in the same block draw without rebinding
+ * anything. Indices stay local to their mesh and are offset at draw time by the mesh's base
+ * vertex, so any mesh of at most 65536 vertices gets 16-bit indices.
+ * Meshes are never removed; the buffers live as long as the OpenGL context.
+ */
+class GeometryPool {
+private:
+	struct Block {
+		VertexLayout layout;
+		GLenum indexType;
+		uint32_t vao;
+		uint32_t vertexBuffer;
+		uint32_t indexBuffer;
+		uint32_t vertexCapacity;
+		uint32_t indexCapacity;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+	};
+
+	std::vector<Block> m_blocks;
+	uint32_t m_vertexCounts[3] = {};
+	size_t m_vertexBytes = 0;
+	size_t m_indexBytes = 0;
+	size_t m_shortIndexMeshes = 0;
+	size_t m_meshes = 0;
+	std::vector<char> m_packed;
+	std::vector<uint16_t> m_shortIndices;
+
+	Block& createBlock(VertexLayout layout, GLenum indexType, uint32_t vertexCapacity, uint32_t indexCapacity);
+
+public:
+	GeometryPool() = default;
+	~GeometryPool();
+	GeometryPool(const GeometryPool&) = delete;
+	GeometryPool& operator=(const GeometryPool&) = delete;
+
+	/**
+	 * @brief Gets the pool every Mesh3D allocates from. Create it only after OpenGL is loaded.
+	 */
+	static GeometryPool& shared();
+
+	/**
+	 * @brief Packs a mesh's vertices into the smallest layout that holds them, and its indices into
+	 * 16 bits when they fit, and copies both into the pool, opening a new block when the current
+	 * block of that layout and index type is full (or a block of its own for a mesh larger than a
+	 * whole block).
+	 */
+	GeometryRange add(const Vertex3D* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+	/**
+	 * @brief Points the layout's attributes (0-3, 4-5 when skinned, 10-11 for eight influences) of
+	 * the bound vertex array
+	 * at a block's vertex buffer, and its
+	 * element buffer at the block's indices, for vertex arrays that add attributes of their own.
+	 */
+	void setUpVertexArray(uint32_t block) const;
+
+	/**
+	 * @brief Binds the vertex array of a mesh's block for drawing it. Use it rather than
+	 * glBindVertexArray(geometry.vao): layouts without eight influences read attribute 11 from
+	 * the context instead of the array, and it resets that value for them.
+	 */
+	void bindVertexArray(const GeometryRange& geometry) const;
+
+	/**
+	 * @brief Binds a vertex array set up for a block with setUpVertexArray, resetting attribute 11
+	 * like bindVertexArray above.
+	 */
+	void bindVertexArray(uint32_t block, uint32_t vao) const;
+
+	size_t getBlockCount() const { return m_blocks.size(); }
+	GLenum getIndexType(uint32_t block) const { return m_blocks[block].indexType; }
+	uint32_t getVertexCount(VertexLayout layout) const { return m_vertexCounts[static_cast<int>(layout)]; }
+	// bytes of packed vertices uploaded so far, and what they would take as Vertex3D
+	size_t getVertexBytes() const { return m_vertexBytes; }
+	size_t getUnpackedVertexBytes() const;
+	// bytes of indices uploaded so far, and how many meshes of how many got 16-bit ones
+	size_t getIndexBytes() const { return m_indexBytes; }
+	size_t getShortIndexMeshCount() const { return m_shortIndexMeshes; }
+	size_t getMeshCount() const { return m_meshes; }
+};
@@ -0,0 +1,230 @@
+#include "IndirectBatch.h"
+#include <algorithm>
+#include <SFML/Window/Context.hpp>
+#include "AssetCache.h"
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// First attribute location of drawModel, a mat4 taking four locations.
+constexpr uint32_t DRAW_MODEL_LOCATION = 6;
+
+typedef void (APIENTRYP MultiDrawElementsIndirect)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+/**
+ * @brief glMultiDrawElementsIndirect (GL 4.3), which the GL 3.3 loader does not provide; null if
+ * the context is older.
+ */
+static MultiDrawElementsIndirect s_multiDrawElementsIndirect() {
+	static MultiDrawElementsIndirect function = [] {
+		GLint major = 0, minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &major);
+		glGetIntegerv(GL_MINOR_VERSION, &minor);
+		if (major < 4 || (major == 4 && minor < 3)) {
+			return static_cast<MultiDrawElementsIndirect>(nullptr);
+		}
+		return reinterpret_cast<MultiDrawElementsIndirect>(sf::Context::getFunction("glMultiDrawElementsIndirect"));
+	}();
+	return function;
+}
+
+/**
+ * @brief Identifies a texture set; layers of one texture array count as different sets, since a
+ * multi-draw call samples a single layer.
+ */
+static uint64_t s_textureSetHash(const std::vector<Texture>& textures) {
+	uint64_t hash = textures.size();
+	for (auto& texture : textures) {
+		hash = hashCombine(hash, texture.textureId);
+		hash = hashCombine(hash, static_cast<uint64_t>(texture.layer));
+		hash = hashCombine(hash, hashBytes(texture.samplerName.data(), texture.samplerName.size()));
+	}
+	return hash;
+}
+
+IndirectBatch::IndirectBatch()
+	: m_commandBuffer(0), m_modelBuffer(0), m_multiDraw(s_multiDrawElementsIndirect() != nullptr) {
+}
+
+IndirectBatch::~IndirectBatch() {
+	release();
+}
+
+void IndirectBatch::release() {
+	if (!m_vertexArrays.empty()) {
+		glDeleteVertexArrays(static_cast<GLsizei>(m_vertexArrays.size()), m_vertexArrays.data());
+		m_vertexArrays.clear();
+	}
+	if (m_commandBuffer) {
+		glDeleteBuffers(1, &m_commandBuffer);
+		m_commandBuffer = 0;
+	}
+	if (m_modelBuffer) {
+		glDeleteBuffers(1, &m_modelBuffer);
+		m_modelBuffer = 0;
+	}
+}
+
+void IndirectBatch::add(const Object3D& object) {
+	m_objects.push_back(&object);
+	m_meshes.clear();
+}
+
+void IndirectBatch::build() {
+	release();
+
+	// Order the meshes by block, then texture set, so each group is a contiguous run of commands.
+	struct Entry {
+		uint32_t block;
+		uint64_t textureSet;
+		uint32_t instance;
+	};
+	std::vector<Entry> entries;
+	for (uint32_t i = 0; i < m_instances.size(); i++) {
+		const Mesh3D& mesh = *m_instances[i].mesh;
+		entries.push_back(Entry{ mesh.getGeometry().block, s_textureSetHash(mesh.getTextures()), i });
+	}
+	std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.block != b.block ? a.block < b.block : a.textureSet < b.textureSet;
+	});
+
+	m_meshes.resize(m_instances.size());
+	m_commandOfInstance.resize(m_instances.size());
+	m_commands.clear();
+	m_groups.clear();
+	uint32_t blockCount = 0;
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		const Mesh3D& mesh = *m_instances[entries[i].instance].mesh;
+		const GeometryRange& geometry = mesh.getGeometry();
+		m_meshes[entries[i].instance] = &mesh;
+		m_commandOfInstance[entries[i].instance] = i;
+		m_commands.push_back(DrawCommand{ geometry.indexCount, 1, geometry.firstIndex, geometry.baseVertex, i });
+
+		if (i == 0 || entries[i].block != entries[i - 1].block || entries[i].textureSet != entries[i - 1].textureSet) {
+			m_groups.push_back(DrawGroup{ entries[i].block, &mesh.getTextures(), i, 0 });
+		}
+		m_groups.back().count++;
+		blockCount = std::max(blockCount, entries[i].block + 1);
+	}
+	m_models.resize(m_commands.size());
+
+	glGenBuffers(1, &m_modelBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_modelBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_models.size() * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (m_multiDraw) {
+		glGenBuffers(1, &m_commandBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawCommand), m_commands.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	m_vertexArrays.resize(blockCount);
+	glGenVertexArrays(blockCount, m_vertexArrays.data());
+	for (uint32_t block = 0; block < blockCount; block++) {
+		glBindVertexArray(m_vertexArrays[block]);
+		GeometryPool::shared().setUpVertexArray(block);
+
+		// drawModel advances once per instance, so a command's base instance selects its matrix.
+		glBindBuffer(GL_ARRAY_BUFFER, m_modelBuffer);
+		for (uint32_t column = 0; column < 4; column++) {
+			glVertexAttribPointer(DRAW_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+				(void*)(column * sizeof(glm::vec4)));
+			glEnableVertexAttribArray(DRAW_MODEL_LOCATION + column);
+			glVertexAttribDivisor(DRAW_MODEL_LOCATION + column, 1);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	glBindVertexArray(0);
+}
+
+void IndirectBatch::update() {
+	m_instances.clear();
+	for (auto object : m_objects) {
+		object->collectMeshes(m_instances);
+	}
+
+	bool changed = m_instances.size() != m_meshes.size();
+	for (size_t i = 0; !changed && i < m_instances.size(); i++) {
+		changed = m_instances[i].mesh != m_meshes[i];
+	}
+	if (changed) {
+		build();
+	}
+	if (m_instances.empty()) {
+		return;
+	}
+
+	for (size_t i = 0; i < m_instances.size(); i++) {
+		m_models[m_commandOfInstance[i]] = m_instances[i].model;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, m_modelBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_models.size() * sizeof(glm::mat4), m_models.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void IndirectBatch::draw(ShaderProgram& program, bool bindTextures) {
+	m_stats = RenderQueueStats();
+	if (m_commands.empty()) {
+		return;
+	}
+	uint64_t uploadsBefore = program.getUniformUploadCount();
+	program.activate();
+	m_stats.programChanges++;
+	const MeshUniforms& uniforms = program.getMeshUniforms();
+	program.setUniform(uniforms.skeletal, false);
+	program.setUniform(uniforms.indirect, m_multiDraw);
+	if (m_multiDraw) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	}
+
+	for (size_t group = 0; group < m_groups.size(); ) {
+		// Without textures, every group of a block goes into one call.
+		uint32_t block = m_groups[group].block;
+		uint32_t first = m_groups[group].first;
+		uint32_t count = 0;
+		size_t next = group;
+		do {
+			count += m_groups[next].count;
+			next++;
+		} while (!bindTextures && next < m_groups.size() && m_groups[next].block == block);
+
+		if (bindTextures) {
+			const std::vector<Texture>& textures = *m_groups[group].textures;
+			Mesh3D::setTextureUniforms(program, textures);
+			for (int i = 0; i < static_cast<int>(textures.size()); i++) {
+				glActiveTexture(GL_TEXTURE0 + i);
+				glBindTexture(textures[i].target(), textures[i].textureId);
+			}
+			m_stats.textureBinds += static_cast<int>(textures.size());
+		}
+		GeometryPool::shared().bindVertexArray(block, m_vertexArrays[block]);
+		m_stats.vertexArrayChanges++;
+
+		// firstIndex counts indices of the block's type, for the indirect commands as for the offsets below.
+		GLenum indexType = GeometryPool::shared().getIndexType(block);
+		if (m_multiDraw) {
+			s_multiDrawElementsIndirect()(GL_TRIANGLES, indexType, (void*)(first * sizeof(DrawCommand)), count, 0);
+			m_stats.draws++;
+		}
+		else {
+			size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+			for (uint32_t i = first; i < first + count; i++) {
+				program.setUniform(uniforms.model, m_models[i]);
+				glDrawElementsBaseVertex(GL_TRIANGLES, m_commands[i].count, indexType,
+					(void*)(m_commands[i].firstIndex * indexSize), m_commands[i].baseVertex);
+			}
+			m_stats.draws += count;
+		}
+		group = next;
+	}
+
+	glBindVertexArray(0);
+	if (m_multiDraw) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		program.setUniform(uniforms.indirect, false);
+	}
+	m_stats.uniformUploads = static_cast<int>(program.getUniformUploadCount() - uploadsBefore);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Object3D.h"
+#include "RenderQueue.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief Draws a fixed set of objects, such as the static scenery, with one
+ * glMultiDrawElementsIndirect per pool block and texture set (one per block when textures are
+ * not needed, as in the shadow pass). Each mesh becomes a DrawElementsIndirectCommand whose base
+ * instance selects its model matrix from a buffer read as the drawModel attribute.
+ * Without multi-draw indirect (OpenGL before 4.3) the same commands are issued one
+ * glDrawElementsBaseVertex at a time with the model uniform.
+ */
+class IndirectBatch {
+private:
+	// Layout of a DrawElementsIndirectCommand.
+	struct DrawCommand {
+		uint32_t count;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+		uint32_t baseInstance;
+	};
+
+	// Consecutive commands sharing a pool block and a texture set.
+	struct DrawGroup {
+		uint32_t block;
+		const std::vector<Texture>* textures;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	std::vector<const Object3D*> m_objects;
+	std::vector<MeshInstance> m_instances;
+	// the mesh and the command of each instance, in collection order
+	std::vector<const Mesh3D*> m_meshes;
+	std::vector<uint32_t> m_commandOfInstance;
+	std::vector<DrawCommand> m_commands;
+	std::vector<DrawGroup> m_groups;
+	std::vector<glm::mat4> m_models;
+
+	uint32_t m_commandBuffer;
+	uint32_t m_modelBuffer;
+	// a vertex array per pool block, with the block's attributes plus drawModel
+	std::vector<uint32_t> m_vertexArrays;
+	bool m_multiDraw;
+	RenderQueueStats m_stats;
+
+	void build();
+	void release();
+
+public:
+	IndirectBatch();
+	~IndirectBatch();
+	IndirectBatch(const IndirectBatch&) = delete;
+	IndirectBatch& operator=(const IndirectBatch&) = delete;
+
+	/**
+	 * @brief Adds an object hierarchy to the batch; it must outlive the batch.
+	 */
+	void add(const Object3D& object);
+
+	/**
+	 * @brief Uploads the objects' current model matrices. Call it once per frame before drawing;
+	 * it rebuilds the commands if the objects' meshes have changed.
+	 */
+	void update();
+
+	/**
+	 * @brief Draws the batch with program, binding each mesh's textures only if bindTextures.
+	 */
+	void draw(ShaderProgram& program, bool bindTextures);
+
+	bool usesMultiDraw() const { return m_multiDraw; }
+	size_t getDrawCount() const { return m_commands.size(); }
+	// What the last draw did, counted as a RenderQueue counts a flush; a multi-draw call counts once.
+	const RenderQueueStats& getStats() const { return m_stats; }
+};
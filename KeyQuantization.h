@@ -0,0 +1,89 @@
+#pragma once
+
+/* 48-bit key encodings used by compressed animation tracks */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/*largest magnitude the three smallest components of a unit quaternion can have: 1 / sqrt(2)*/
+constexpr float SMALLEST_THREE_RANGE = 0.70710678f;
+constexpr int SMALLEST_THREE_MAX = (1 << 15) - 1;
+constexpr int RANGE48_MAX = (1 << 16) - 1;
+
+/**
+ * @brief Encodes a rotation as 2 bits for the index of its largest component and 15 bits for each
+ * of the other three; the largest is recovered from the unit length and is made positive by
+ * negating the quaternion, which describes the same rotation.
+ */
+inline void EncodeSmallestThree(const glm::quat& rotation, uint16_t* words)
+{
+	glm::quat q = glm::normalize(rotation);
+	float components[4] = { q.x, q.y, q.z, q.w };
+
+	int largest = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		if (std::fabs(components[i]) > std::fabs(components[largest]))
+			largest = i;
+	}
+	float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+	uint64_t bits = static_cast<uint64_t>(largest);
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		float normalized = (components[i] * sign / SMALLEST_THREE_RANGE) * 0.5f + 0.5f;
+		normalized = std::fmin(std::fmax(normalized, 0.0f), 1.0f);
+		bits = (bits << 15) | static_cast<uint64_t>(std::lround(normalized * SMALLEST_THREE_MAX));
+	}
+
+	words[0] = static_cast<uint16_t>(bits >> 32);
+	words[1] = static_cast<uint16_t>(bits >> 16);
+	words[2] = static_cast<uint16_t>(bits);
+}
+
+inline glm::quat DecodeSmallestThree(const uint16_t* words)
+{
+	uint64_t bits = (static_cast<uint64_t>(words[0]) << 32) | (static_cast<uint64_t>(words[1]) << 16) | words[2];
+	int largest = static_cast<int>(bits >> 45);
+
+	float components[4];
+	float sumOfSquares = 0.0f;
+	int shift = 30;
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		float normalized = static_cast<float>((bits >> shift) & SMALLEST_THREE_MAX) / SMALLEST_THREE_MAX;
+		components[i] = (normalized * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+		sumOfSquares += components[i] * components[i];
+		shift -= 15;
+	}
+	components[largest] = std::sqrt(std::fmax(1.0f - sumOfSquares, 0.0f));
+
+	return glm::quat(components[3], components[0], components[1], components[2]);
+}
+
+/**
+ * @brief Encodes a vector as three 16-bit fractions of a per-track range,
+ * value = rangeMin + word * rangeStep.
+ */
+inline void EncodeRange48(const glm::vec3& value, const glm::vec3& rangeMin, const glm::vec3& rangeStep, uint16_t* words)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		long word = rangeStep[i] > 0.0f ? std::lround((value[i] - rangeMin[i]) / rangeStep[i]) : 0;
+		words[i] = static_cast<uint16_t>(std::min(std::max(word, 0L), static_cast<long>(RANGE48_MAX)));
+	}
+}
+
+inline glm::vec3 DecodeRange48(const uint16_t* words, const glm::vec3& rangeMin, const glm::vec3& rangeStep)
+{
+	return glm::vec3(rangeMin.x + words[0] * rangeStep.x,
+		rangeMin.y + words[1] * rangeStep.y,
+		rangeMin.z + words[2] * rangeStep.z);
+}
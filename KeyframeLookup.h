@@ -0,0 +1,52 @@
+#pragma once
+
+/* Keyframe search shared by every animation track */
+
+#include <algorithm>
+
+/*how many keys the cursor may walk forward before giving up and binary searching*/
+constexpr int KEYFRAME_CURSOR_MAX_STEPS = 4;
+
+/**
+ * @brief Finds the index of the key that starts the segment [index, index + 1] containing
+ * animationTime, in a track of at least two sorted key timestamps.
+ * @param cursor the segment returned by the previous lookup on this track. Monotonic playback
+ * only walks it forward by a key or two; seeks and loops fall back to a binary search.
+ * Times before the first key clamp to the first segment, times at or past the last key clamp
+ * to the last segment.
+ */
+inline int FindKeyIndex(const float* timeStamps, int keyCount, float animationTime, int& cursor)
+{
+	const int lastSegment = keyCount - 2;
+
+	if (animationTime >= timeStamps[lastSegment + 1])
+		return cursor = lastSegment;
+	if (animationTime < timeStamps[1])
+		return cursor = 0;
+
+	int index = std::min(std::max(cursor, 0), lastSegment);
+	if (timeStamps[index] <= animationTime)
+	{
+		// animationTime is below the last key, so the walk always stops at lastSegment at the latest.
+		for (int step = 0; step < KEYFRAME_CURSOR_MAX_STEPS; ++step, ++index)
+		{
+			if (animationTime < timeStamps[index + 1])
+				return cursor = index;
+		}
+	}
+
+	const float* next = std::upper_bound(timeStamps + 1, timeStamps + keyCount, animationTime);
+	return cursor = static_cast<int>(next - timeStamps) - 1;
+}
+
+/**
+ * @brief Gets how far animationTime lies between two key timestamps, clamped to [0, 1].
+ */
+inline float GetKeyBlendFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
+{
+	float framesDiff = nextTimeStamp - lastTimeStamp;
+	if (framesDiff <= 0.0f)
+		return 0.0f;
+	float scaleFactor = (animationTime - lastTimeStamp) / framesDiff;
+	return std::min(std::max(scaleFactor, 0.0f), 1.0f);
+}
@@ -16,56 +16,11 @@ Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 }
 
 Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, std::vector<Texture>&& textures)
-	: m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(textures) {
-
-	// Generate a vertex array object on the GPU.
-	glGenVertexArrays(1, &m_vao);
-	// "Bind" the newly-generated vao, which makes future functions operate on that specific object.
-	glBindVertexArray(m_vao);
-
-	// Generate a vertex buffer object on the GPU.
-	uint32_t vbo;
-	glGenBuffers(1, &vbo);
-
-	// "Bind" the newly-generated vbo, which makes future functions operate on that specific object.
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	// This vbo is now associated with m_vao.
-	// Copy the contents of the vertices list to the buffer that lives on the GPU.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex3D), &vertices[0], GL_STATIC_DRAW);
-
-	// Inform OpenGL how to interpret the buffer. Each vertex now has TWO attributes; a position and a color.
-	// Atrribute 0 is position: 3 contiguous floats (x/y/z)...
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), 0);
-	glEnableVertexAttribArray(0);
-
-	// Attribute 1 is normal (nx, ny, nz): 3 contiguous floats, starting 12 bytes after the beginning of the vertex.
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, Normal));
-	glEnableVertexAttribArray(1);
-
-	// Attribute 2 is texture coordinates (u, v): 2 contiguous floats, starting 24 bytes after the beginning of the vertex.
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, TexCoords));
-	glEnableVertexAttribArray(2);
-
-	// add: tangent vector
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, Tangent));
-	glEnableVertexAttribArray(3);
-
-	// bones id
-	glVertexAttribIPointer(4, 4, GL_INT, sizeof(Vertex3D), (void*)offsetof(Vertex3D, m_BoneIDs));
-	glEnableVertexAttribArray(4);
-
-	// weights
-	glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex3D), (void*)offsetof(Vertex3D, m_Weights));
-	glEnableVertexAttribArray(5);
-
-	// Generate a second buffer, to store the indices of each triangle in the mesh.
-	uint32_t ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(uint32_t), &faces[0], GL_STATIC_DRAW);
-
-	// Unbind the vertex array, so no one else can accidentally mess with it.
-	glBindVertexArray(0);
+	: m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(std::move(textures)) {
+
+	// Copy the vertices and faces into the shared geometry buffers on the GPU.
+	m_geometry = GeometryPool::shared().add(vertices.data(), static_cast<uint32_t>(vertices.size()),
+		faces.data(), static_cast<uint32_t>(faces.size()));
 }
 
 void Mesh3D::addTexture(Texture texture)
@@ -73,28 +28,62 @@ void Mesh3D::addTexture(Texture texture)
 	m_textures.push_back(texture);
 }
 
+// Units no mesh texture is bound to, for the samplers a mesh leaves unused: a sampler2D and a
+// sampler2DArray may never point at the same unit, even if the shader only samples one of them.
+constexpr int UNUSED_SAMPLER_UNIT = 14;
+constexpr int UNUSED_ARRAY_SAMPLER_UNIT = 15;
+
+void Mesh3D::setTextureUniforms(ShaderProgram& program, const std::vector<Texture>& textures) {
+	const MeshUniforms& uniforms = program.getMeshUniforms();
+	int baseTexture = UNUSED_SAMPLER_UNIT;
+	int baseTextureArray = UNUSED_ARRAY_SAMPLER_UNIT;
+	int baseTextureLayer = -1;
+	int normalMap = UNUSED_SAMPLER_UNIT;
+	int specularMap = UNUSED_SAMPLER_UNIT;
+
+	// Texture i is bound to unit i; point its sampler there.
+	for (int i = 0; i < static_cast<int>(textures.size()); i++) {
+		const std::string& samplerName = textures[i].samplerName;
+		if (samplerName == "baseTexture" && textures[i].layer >= 0) {
+			baseTextureArray = i;
+			baseTextureLayer = textures[i].layer;
+		}
+		else if (samplerName == "baseTexture") {
+			baseTexture = i;
+		}
+		else if (samplerName == "normalMap") {
+			normalMap = i;
+		}
+		else if (samplerName == "specularMap") {
+			specularMap = i;
+		}
+		else {
+			program.setUniform(samplerName, i);
+		}
+	}
+	program.setUniform(uniforms.baseTexture, baseTexture);
+	program.setUniform(uniforms.baseTextureArray, baseTextureArray);
+	program.setUniform(uniforms.baseTextureLayer, baseTextureLayer);
+	program.setUniform(uniforms.normalMap, normalMap);
+	program.setUniform(uniforms.specularMap, specularMap);
+	program.setUniform(uniforms.hasNormalMap, normalMap != UNUSED_SAMPLER_UNIT);
+	program.setUniform(uniforms.hasSpecularMap, specularMap != UNUSED_SAMPLER_UNIT);
+}
+
 void Mesh3D::render(sf::RenderWindow& window, ShaderProgram& program) const {
-	// Activate the mesh's vertex array.
-	glBindVertexArray(m_vao);
-	program.setUniform("hasNormalMap", false);
-	program.setUniform("hasSpecularMap", false);
+	// Activate the vertex array of the pool block holding the mesh.
+	GeometryPool::shared().bindVertexArray(m_geometry);
+	setTextureUniforms(program, m_textures);
 
 	for (auto i = 0; i < m_textures.size(); i++) {
 		//std::cout << m_textures[i].samplerName << " ";
-		if (m_textures[i].samplerName == "normalMap") {
-			program.setUniform("hasNormalMap", true);
-		}
-		else if (m_textures[i].samplerName == "specularMap") {
-			program.setUniform("hasSpecularMap", true);
-		}
-
-		program.setUniform(m_textures[i].samplerName, i);
 		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textures[i].textureId);
+		glBindTexture(m_textures[i].target(), m_textures[i].textureId);
 	}
 
-	// Draw the vertex array, using its "element buffer" to identify the faces.
-	glDrawElements(GL_TRIANGLES, m_faceCount, GL_UNSIGNED_INT, nullptr);
+	// Draw the mesh's range of the block's "element buffer", which identifies the faces.
+	glDrawElementsBaseVertex(GL_TRIANGLES, m_faceCount, m_geometry.indexType,
+		m_geometry.indexOffset(), m_geometry.baseVertex);
 	// Deactivate the mesh's vertex array and texture.
 	glBindVertexArray(0);
 	glBindTexture(GL_TEXTURE_2D, 0);
@@ -171,7 +160,8 @@ Mesh3D Mesh3D::square(const std::vector<Texture>& textures) {
 
 Mesh3D Mesh3D::cube(Texture texture) {
 	std::vector<Vertex3D> vertices;
-	Vertex3D a;
+	// Zeroed, so the cube carries no bone influences.
+	Vertex3D a{};
 	a.Position = glm::vec3(-1.0f, -1.0f, 1.0f);
 	a.TexCoords = glm::vec2(0, 0);
 	vertices.push_back(a);
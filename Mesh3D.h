@@ -2,10 +2,15 @@
 #include <SFML/Graphics.hpp>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
+#include "GeometryPool.h"
 #include "ShaderProgram.h"
 #include "Texture.h"
 
-constexpr int MAX_BONE_PER_VERTEX = 4;
+/**
+ * @brief Bone influences a Vertex3D can hold. Models are imported with fewer (see Skeletal);
+ * influences are sorted by decreasing weight and unused slots have bone -1 and weight 0.
+ */
+constexpr int MAX_BONE_PER_VERTEX = 8;
 
 struct Vertex3D {
 	// position
@@ -25,11 +30,12 @@ struct Vertex3D {
 
 /**
  * @brief Represents a mesh whose vertices have positions, normal vectors, and texture coordinates;
- * as well as a list of Textures to bind when rendering the mesh.
+ * as well as a list of Textures to bind when rendering the mesh. The geometry itself is stored in
+ * the shared GeometryPool.
  */
 class Mesh3D {
 private:
-	uint32_t m_vao;
+	GeometryRange m_geometry;
 	std::vector<Texture> m_textures;
 	size_t m_vertexCount;
 	size_t m_faceCount;
@@ -48,6 +54,12 @@ public:
 
 	void addTexture(Texture texture);
 
+	// Draw state, for a RenderQueue.
+	inline uint32_t getVertexArray() const { return m_geometry.vao; }
+	inline const GeometryRange& getGeometry() const { return m_geometry; }
+	inline size_t getFaceCount() const { return m_faceCount; }
+	inline const std::vector<Texture>& getTextures() const { return m_textures; }
+
 	/**
 	 * @brief Constructs a 1x1 square centered at the origin in world space.
 	*/
@@ -57,6 +69,13 @@ public:
 	*/
 	static Mesh3D cube(Texture texture);
 
+	/**
+	 * @brief Points the program's samplers at texture units for textures bound in order to units
+	 * 0, 1, ..., and sets hasNormalMap and hasSpecularMap to match. A base texture that is a layer
+	 * of a texture array goes to baseTextureArray, with baseTextureLayer set to its layer.
+	 */
+	static void setTextureUniforms(ShaderProgram& program, const std::vector<Texture>& textures);
+
 	/**
 	 * @brief Renders the mesh to the given context.
 	 */
@@ -0,0 +1,300 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "Mesh3D.h"
+
+// Entries of the FIFO cache the stats and the overdraw clusters are measured with.
+constexpr size_t ANALYZE_CACHE_SIZE = 16;
+// Entries of the LRU cache optimizeVertexCache scores vertices against.
+constexpr int OPTIMIZE_CACHE_SIZE = 32;
+
+VertexCacheStats& VertexCacheStats::operator+=(const VertexCacheStats& other) {
+	transformed += other.transformed;
+	triangles += other.triangles;
+	vertices += other.vertices;
+	return *this;
+}
+
+/**
+ * @brief A FIFO post-transform cache, simulated by remembering when each vertex went in: a vertex
+ * is still cached if fewer than ANALYZE_CACHE_SIZE vertices went in after it.
+ */
+class FifoCache {
+private:
+	std::vector<size_t> m_insertedAt;
+	size_t m_time;
+
+public:
+	explicit FifoCache(size_t vertexCount) : m_insertedAt(vertexCount, 0), m_time(ANALYZE_CACHE_SIZE + 1) {}
+
+	// Returns true on a miss.
+	bool fetch(uint32_t vertex) {
+		if (m_time - m_insertedAt[vertex] <= ANALYZE_CACHE_SIZE) {
+			return false;
+		}
+		m_insertedAt[vertex] = m_time++;
+		return true;
+	}
+
+	void clear() { m_time += ANALYZE_CACHE_SIZE + 1; }
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	VertexCacheStats stats;
+	stats.triangles = indexCount / 3;
+	FifoCache cache(vertexCount);
+	std::vector<bool> used(vertexCount, false);
+	for (size_t i = 0; i < indexCount; i++) {
+		if (!used[indices[i]]) {
+			used[indices[i]] = true;
+			stats.vertices++;
+		}
+		if (cache.fetch(indices[i])) {
+			stats.transformed++;
+		}
+	}
+	return stats;
+}
+
+/**
+ * @brief How much drawing a vertex's triangles now is worth: more the more recently it was used,
+ * and more the fewer triangles it has left, so lone triangles do not stay behind.
+ */
+static float s_vertexScore(int cachePosition, uint32_t remainingTriangles) {
+	if (remainingTriangles == 0) {
+		return -1.0f;
+	}
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		// The last triangle's vertices all get the same score, or the next triangle would tend
+		// to be the one sharing the strip's oldest edge.
+		if (cachePosition < 3) {
+			score = 0.75f;
+		}
+		else {
+			float scale = 1.0f / (OPTIMIZE_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+		}
+	}
+	return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	size_t triangleCount = indexCount / 3;
+
+	// The triangles not drawn yet of each vertex, as a range of adjacency.
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		remaining[indices[i]]++;
+	}
+	std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+		firstTriangle[vertex + 1] = firstTriangle[vertex] + remaining[vertex];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[filled[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+		vertexScore[vertex] = s_vertexScore(-1, remaining[vertex]);
+	}
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	size_t cursor = 0;
+	int64_t best = -1;
+	while (result.size() < triangleCount * 3) {
+		if (best < 0) {
+			// Nothing in the cache is left to draw: start again from the first triangle not drawn.
+			while (emitted[cursor]) {
+				cursor++;
+			}
+			best = static_cast<int64_t>(cursor);
+		}
+		const uint32_t* triangle = indices + best * 3;
+		emitted[best] = true;
+		result.insert(result.end(), triangle, triangle + 3);
+
+		// The triangle's vertices move to the front of the cache, pushing the others back.
+		nextCache.clear();
+		for (int k = 0; k < 3; k++) {
+			if (std::find(nextCache.begin(), nextCache.end(), triangle[k]) == nextCache.end()) {
+				nextCache.push_back(triangle[k]);
+			}
+		}
+		size_t drawnVertices = nextCache.size();
+		for (uint32_t vertex : cache) {
+			auto drawnEnd = nextCache.begin() + drawnVertices;
+			if (std::find(nextCache.begin(), drawnEnd, vertex) == drawnEnd) {
+				nextCache.push_back(vertex);
+			}
+		}
+		for (int k = 0; k < 3; k++) {
+			uint32_t* begin = adjacency.data() + firstTriangle[triangle[k]];
+			uint32_t* end = begin + remaining[triangle[k]];
+			uint32_t* found = std::find(begin, end, static_cast<uint32_t>(best));
+			if (found != end) {
+				*found = *(end - 1);
+				remaining[triangle[k]]--;
+			}
+		}
+
+		// Rescore the vertices whose cache position changed, and the triangles left around them;
+		// the best of those is drawn next.
+		for (size_t i = 0; i < nextCache.size(); i++) {
+			uint32_t vertex = nextCache[i];
+			cachePosition[vertex] = i < OPTIMIZE_CACHE_SIZE ? static_cast<int>(i) : -1;
+			vertexScore[vertex] = s_vertexScore(cachePosition[vertex], remaining[vertex]);
+		}
+		best = -1;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < nextCache.size() && i < OPTIMIZE_CACHE_SIZE; i++) {
+			uint32_t vertex = nextCache[i];
+			for (uint32_t j = 0; j < remaining[vertex]; j++) {
+				uint32_t candidate = adjacency[firstTriangle[vertex] + j];
+				const uint32_t* corners = indices + candidate * 3;
+				float score = vertexScore[corners[0]] + vertexScore[corners[1]] + vertexScore[corners[2]];
+				if (score > bestScore) {
+					bestScore = score;
+					best = candidate;
+				}
+			}
+		}
+		nextCache.resize(std::min(nextCache.size(), static_cast<size_t>(OPTIMIZE_CACHE_SIZE)));
+		std::swap(cache, nextCache);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex3D* vertices, size_t vertexCount,
+	float threshold) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Cut the triangles into clusters where the cache starts cold anyway: at triangles missing on
+	// all three vertices.
+	std::vector<size_t> hardBoundaries;
+	FifoCache cache(vertexCount);
+	for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+		int misses = 0;
+		for (int k = 0; k < 3; k++) {
+			misses += cache.fetch(indices[triangle * 3 + k]);
+		}
+		if (triangle == 0 || misses == 3) {
+			hardBoundaries.push_back(triangle);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Cut those further wherever the cluster so far is nearly as cache-friendly as the whole.
+	std::vector<size_t> boundaries;
+	for (size_t cluster = 0; cluster + 1 < hardBoundaries.size(); cluster++) {
+		size_t start = hardBoundaries[cluster];
+		size_t end = hardBoundaries[cluster + 1];
+		cache.clear();
+		size_t clusterMisses = 0;
+		for (size_t i = start * 3; i < end * 3; i++) {
+			clusterMisses += cache.fetch(indices[i]);
+		}
+		float limit = threshold * clusterMisses / (end - start);
+
+		boundaries.push_back(start);
+		cache.clear();
+		size_t misses = 0;
+		for (size_t triangle = start; triangle + 1 < end; triangle++) {
+			for (int k = 0; k < 3; k++) {
+				misses += cache.fetch(indices[triangle * 3 + k]);
+			}
+			size_t drawn = triangle + 1 - boundaries.back();
+			if (static_cast<float>(misses) / drawn <= limit) {
+				boundaries.push_back(triangle + 1);
+				cache.clear();
+				misses = 0;
+			}
+		}
+	}
+	boundaries.push_back(triangleCount);
+
+	// Draw first the clusters facing most away from the mesh's center: from most viewpoints they
+	// are in front of the rest.
+	struct Cluster {
+		size_t start;
+		size_t end;
+		float outwardness;
+	};
+	std::vector<Cluster> clusters;
+	std::vector<glm::vec3> centroids;
+	std::vector<glm::vec3> normals;
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t cluster = 0; cluster + 1 < boundaries.size(); cluster++) {
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (size_t triangle = boundaries[cluster]; triangle < boundaries[cluster + 1]; triangle++) {
+			const glm::vec3& a = vertices[indices[triangle * 3]].Position;
+			const glm::vec3& b = vertices[indices[triangle * 3 + 1]].Position;
+			const glm::vec3& c = vertices[indices[triangle * 3 + 2]].Position;
+			glm::vec3 cross = glm::cross(b - a, c - a);
+			float triangleArea = glm::length(cross);
+			centroid += (a + b + c) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		centroids.push_back(area > 0.0f ? centroid / area : centroid);
+		normals.push_back(normal);
+		clusters.push_back(Cluster{ boundaries[cluster], boundaries[cluster + 1], 0.0f });
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid = meshCentroid / meshArea;
+	}
+	for (size_t cluster = 0; cluster < clusters.size(); cluster++) {
+		float length = glm::length(normals[cluster]);
+		if (length > 0.0f) {
+			clusters[cluster].outwardness = glm::dot(centroids[cluster] - meshCentroid, normals[cluster] / length);
+		}
+	}
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const Cluster& a, const Cluster& b) { return a.outwardness > b.outwardness; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (auto& cluster : clusters) {
+		sorted.insert(sorted.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+	}
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void optimizeVertexFetch(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& indices) {
+	constexpr uint32_t UNUSED = UINT32_MAX;
+	std::vector<uint32_t> remap(vertices.size(), UNUSED);
+	std::vector<Vertex3D> reordered;
+	reordered.reserve(vertices.size());
+	for (auto& index : indices) {
+		if (remap[index] == UNUSED) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices = std::move(reordered);
+}
+
+void optimizeMesh(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& indices) {
+	optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+	optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+	optimizeVertexFetch(vertices, indices);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex3D;
+
+/**
+ * @brief How well an index buffer uses a simulated post-transform vertex cache (a 16-entry FIFO,
+ * as on most GPUs of the OpenGL 3-4 era). Stats of several meshes can be added together.
+ */
+struct VertexCacheStats {
+	// vertices transformed, i.e. cache misses
+	size_t transformed = 0;
+	size_t triangles = 0;
+	// distinct vertices referenced
+	size_t vertices = 0;
+
+	// average cache miss ratio: vertices transformed per triangle, 0.5 at best and 3 at worst
+	float acmr() const { return triangles ? static_cast<float>(transformed) / triangles : 0.0f; }
+	// average transform to vertex ratio: 1 at best
+	float atvr() const { return vertices ? static_cast<float>(transformed) / vertices : 0.0f; }
+
+	VertexCacheStats& operator+=(const VertexCacheStats& other);
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+/**
+ * @brief Reorders triangles so that consecutive triangles share vertices while they are still in
+ * the post-transform cache (Tom Forsyth's linear-speed vertex cache optimization).
+ */
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+/**
+ * @brief Reorders runs of triangles of a cache-optimized index buffer so that those facing out of
+ * the mesh come first and hide what is behind them, whatever the view direction. Runs are cut
+ * where the cache would be cold anyway, or where cutting costs at most threshold times the ACMR,
+ * so cache efficiency is mostly kept.
+ */
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex3D* vertices, size_t vertexCount,
+	float threshold = 1.05f);
+
+/**
+ * @brief Renumbers the vertices in the order the indices first use them, so vertex fetch walks the
+ * buffer forward; vertices no index uses are dropped.
+ */
+void optimizeVertexFetch(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& indices);
+
+/**
+ * @brief Runs the three optimizations above in order on a mesh.
+ */
+void optimizeMesh(std::vector<Vertex3D>& vertices, std::vector<uint32_t>& indices);
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BoneInfo.h"
+#include "Mesh3D.h"
+
+/**
+ * @brief A texture file used by a model, and the sampler it binds to; or a layer of a texture
+ * array packed from several files, which path then only names.
+ */
+struct TextureReference {
+	std::string path;
+	std::string samplerName;
+	// the image file of each layer of the array, and the layer this reference samples; -1 for a plain texture
+	std::vector<std::string> arrayLayers;
+	int layer = -1;
+};
+
+/**
+ * @brief The CPU-side contents of one mesh, before anything is uploaded to the GPU.
+ */
+struct MeshData {
+	std::vector<Vertex3D> vertices;
+	std::vector<uint32_t> faces;
+	// Indices into ModelData::textures.
+	std::vector<int> textures;
+};
+
+/**
+ * @brief One node of a model's hierarchy. Nodes are stored in depth-first order, so the root is node 0.
+ */
+struct ModelNodeData {
+	glm::mat4 transformation;
+	// Indices into ModelData::meshes and ModelData::nodes.
+	std::vector<int> meshes;
+	std::vector<int> children;
+};
+
+/**
+ * @brief Everything an import produces for a model, independent of OpenGL; this is what the
+ * asset cache stores and what Skeletal turns into an Object3D hierarchy.
+ */
+struct ModelData {
+	std::vector<MeshData> meshes;
+	std::vector<ModelNodeData> nodes;
+	std::vector<TextureReference> textures;
+	std::unordered_map<std::string, BoneInfo> boneInfoMap;
+	int boneCount = 0;
+};
@@ -2,49 +2,157 @@
 #include <glm/gtx/string_cast.hpp>
 #include <glm/ext.hpp>
 #include "Object3D.h"
+#include "RenderQueue.h"
 #include <iostream>
 
-void Object3D::rebuildModelMatrix() {
-	auto m = glm::translate(glm::mat4(1), m_position);
-	m = glm::translate(m, m_center * m_scale);
-	m = glm::rotate(m, m_orientation[2], glm::vec3(0, 0, 1));
-	m = glm::rotate(m, m_orientation[0], glm::vec3(1, 0, 0));
-	m = glm::rotate(m, m_orientation[1], glm::vec3(0, 1, 0));
-	m = glm::scale(m, m_scale);
-	m = glm::translate(m, -m_center);
-	m = m * m_baseTransform;
-	m_modelMatrix = m;
-}
-
 Object3D::Object3D(std::vector<Mesh3D>&& meshes)
 	: Object3D(std::move(meshes), glm::mat4(1)) {
-	rebuildModelMatrix();
 }
 
 Object3D::Object3D(std::vector<Mesh3D>&& meshes, const glm::mat4& baseTransform)
-	: m_meshes(meshes), m_position(), m_orientation(), m_scale(1.0),
-	m_center(), m_baseTransform(baseTransform)
+	: m_meshes(std::move(meshes)), m_transform(TransformHierarchy::shared().create(baseTransform))
+{
+}
+
+Object3D::Object3D(const Object3D& other) {
+	*this = other;
+}
+
+/**
+ * @brief Takes over the other object's transform, and with it its place under a parent: a vector
+ * of children moving its objects keeps them where they were.
+ */
+Object3D::Object3D(Object3D&& other) noexcept
+	: m_meshes(std::move(other.m_meshes)), m_children(std::move(other.m_children)), m_transform(other.m_transform),
+	m_name(std::move(other.m_name)), velocity(other.velocity), rotational_velocity(other.rotational_velocity),
+	rotational_acceleration(other.rotational_acceleration), forces_list(std::move(other.forces_list)), mass(other.mass)
 {
-	rebuildModelMatrix();
+	other.m_transform = TransformHierarchy::NO_TRANSFORM;
+}
+
+/**
+ * @brief Copies the other object's local transform, meshes and children (into new transforms),
+ * keeping this object's place under its parent.
+ */
+Object3D& Object3D::operator=(const Object3D& other) {
+	if (this == &other) {
+		return *this;
+	}
+	if (other.m_transform != TransformHierarchy::NO_TRANSFORM) {
+		TransformHierarchy::shared().copyLocal(other.m_transform, ensureTransform());
+	}
+	else if (m_transform != TransformHierarchy::NO_TRANSFORM) {
+		TransformHierarchy::shared().resetLocal(m_transform);
+	}
+	m_meshes = other.m_meshes;
+	m_children = other.m_children;
+	adoptChildren();
+	m_name = other.m_name;
+	velocity = other.velocity;
+	rotational_velocity = other.rotational_velocity;
+	rotational_acceleration = other.rotational_acceleration;
+	forces_list = other.forces_list;
+	mass = other.mass;
+	return *this;
+}
+
+/**
+ * @brief Like copy assignment, but takes the other object's meshes and children. An object
+ * without a transform takes the other's; either way the other is left without one.
+ */
+Object3D& Object3D::operator=(Object3D&& other) noexcept {
+	if (this == &other) {
+		return *this;
+	}
+	auto& hierarchy = TransformHierarchy::shared();
+	if (m_transform == TransformHierarchy::NO_TRANSFORM) {
+		m_transform = other.m_transform;
+	}
+	else if (other.m_transform != TransformHierarchy::NO_TRANSFORM) {
+		hierarchy.copyLocal(other.m_transform, m_transform);
+		hierarchy.destroy(other.m_transform);
+	}
+	else {
+		hierarchy.resetLocal(m_transform);
+	}
+	other.m_transform = TransformHierarchy::NO_TRANSFORM;
+	m_meshes = std::move(other.m_meshes);
+	m_children = std::move(other.m_children);
+	adoptChildren();
+	m_name = std::move(other.m_name);
+	velocity = other.velocity;
+	rotational_velocity = other.rotational_velocity;
+	rotational_acceleration = other.rotational_acceleration;
+	forces_list = std::move(other.forces_list);
+	mass = other.mass;
+	return *this;
+}
+
+Object3D::~Object3D() {
+	if (m_transform != TransformHierarchy::NO_TRANSFORM) {
+		TransformHierarchy::shared().destroy(m_transform);
+	}
+}
+
+/**
+ * @brief Gets the object's transform, creating it for an object made without one or moved from.
+ */
+uint32_t Object3D::ensureTransform() {
+	if (m_transform == TransformHierarchy::NO_TRANSFORM) {
+		m_transform = TransformHierarchy::shared().create();
+	}
+	return m_transform;
 }
 
-const glm::vec3& Object3D::getPosition() const {
-	return m_position;
+void Object3D::adoptChildren() {
+	if (m_children.empty()) {
+		return;
+	}
+	auto& hierarchy = TransformHierarchy::shared();
+	uint32_t transform = ensureTransform();
+	for (auto& child : m_children) {
+		hierarchy.setParent(child.ensureTransform(), transform);
+	}
+}
+
+// An object without a transform reads as an unmoved root.
+glm::vec3 Object3D::getPosition() const {
+	if (m_transform == TransformHierarchy::NO_TRANSFORM) {
+		return glm::vec3(0);
+	}
+	return TransformHierarchy::shared().getPosition(m_transform);
 }
 
-const glm::vec3& Object3D::getOrientation() const {
-	return m_orientation;
+glm::vec3 Object3D::getOrientation() const {
+	if (m_transform == TransformHierarchy::NO_TRANSFORM) {
+		return glm::vec3(0);
+	}
+	return TransformHierarchy::shared().getOrientation(m_transform);
 }
 
-const glm::vec3& Object3D::getScale() const {
-	return m_scale;
+glm::vec3 Object3D::getScale() const {
+	if (m_transform == TransformHierarchy::NO_TRANSFORM) {
+		return glm::vec3(1);
+	}
+	return TransformHierarchy::shared().getScale(m_transform);
 }
 
 /**
  * @brief Gets the center of the object's rotation.
  */
-const glm::vec3& Object3D::getCenter() const {
-	return m_center;
+glm::vec3 Object3D::getCenter() const {
+	if (m_transform == TransformHierarchy::NO_TRANSFORM) {
+		return glm::vec3(0);
+	}
+	return TransformHierarchy::shared().getCenter(m_transform);
+}
+
+const glm::mat4& Object3D::getWorldMatrix() const {
+	static const glm::mat4 identity(1);
+	if (m_transform == TransformHierarchy::NO_TRANSFORM) {
+		return identity;
+	}
+	return TransformHierarchy::shared().getWorldMatrix(m_transform);
 }
 
 const std::string& Object3D::getName() const {
@@ -64,18 +172,15 @@ Object3D& Object3D::getChild(size_t index) {
 }
 
 void Object3D::setPosition(const glm::vec3& position) {
-	m_position = position;
-	rebuildModelMatrix();
+	TransformHierarchy::shared().setPosition(ensureTransform(), position);
 }
 
 void Object3D::setOrientation(const glm::vec3& orientation) {
-	m_orientation = orientation;
-	rebuildModelMatrix();
+	TransformHierarchy::shared().setOrientation(ensureTransform(), orientation);
 }
 
 void Object3D::setScale(const glm::vec3& scale) {
-	m_scale = scale;
-	rebuildModelMatrix();
+	TransformHierarchy::shared().setScale(ensureTransform(), scale);
 }
 
 /**
@@ -84,7 +189,7 @@ void Object3D::setScale(const glm::vec3& scale) {
  */
 void Object3D::setCenter(const glm::vec3& center)
 {
-	m_center = center;
+	TransformHierarchy::shared().setCenter(ensureTransform(), center);
 }
 
 void Object3D::setName(const std::string& name) {
@@ -92,44 +197,79 @@ void Object3D::setName(const std::string& name) {
 }
 
 void Object3D::move(const glm::vec3& offset) {
-	m_position = m_position + offset;
-	rebuildModelMatrix();
+	auto& hierarchy = TransformHierarchy::shared();
+	uint32_t transform = ensureTransform();
+	hierarchy.setPosition(transform, hierarchy.getPosition(transform) + offset);
 }
 
 void Object3D::rotate(const glm::vec3& rotation) {
-	m_orientation = m_orientation + rotation;
-	rebuildModelMatrix();
+	auto& hierarchy = TransformHierarchy::shared();
+	uint32_t transform = ensureTransform();
+	hierarchy.setOrientation(transform, hierarchy.getOrientation(transform) + rotation);
 }
 
 void Object3D::grow(const glm::vec3& growth) {
-	m_scale = m_scale * growth;
-	rebuildModelMatrix();
+	auto& hierarchy = TransformHierarchy::shared();
+	uint32_t transform = ensureTransform();
+	hierarchy.setScale(transform, hierarchy.getScale(transform) * growth);
 }
 
 void Object3D::addChild(Object3D&& child)
 {
-	m_children.emplace_back(child);
+	TransformHierarchy::shared().setParent(child.ensureTransform(), ensureTransform());
+	m_children.push_back(std::move(child));
+}
+
+void Object3D::reserveChildren(size_t count)
+{
+	m_children.reserve(count);
 }
 
 void Object3D::render(sf::RenderWindow& window, ShaderProgram& shaderProgram) const {
-	renderRecursive(window, shaderProgram, glm::mat4(1));
+	renderRecursive(window, shaderProgram);
 }
 
 /**
  * @brief Renders the object and its children, recursively.
- * @param parentMatrix the model matrix of this object's parent in the model hierarchy.
  */
-void Object3D::renderRecursive(sf::RenderWindow& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const {
-	// This object's true model matrix is the combination of its parent's matrix and the object's matrix.
-	glm::mat4 trueModel = parentMatrix * m_modelMatrix;
-	shaderProgram.setUniform("model", trueModel);
+void Object3D::renderRecursive(sf::RenderWindow& window, ShaderProgram& shaderProgram) const {
+	shaderProgram.setUniform(shaderProgram.getMeshUniforms().model, getWorldMatrix());
 	// Render each mesh in the object.
 	for (auto& mesh : m_meshes) {
 		mesh.render(window, shaderProgram);
 	}
 	// Render the children of the object.
 	for (auto& child : m_children) {
-		child.renderRecursive(window, shaderProgram, trueModel);
+		child.renderRecursive(window, shaderProgram);
+	}
+}
+
+void Object3D::submit(RenderQueue& queue, ShaderProgram& shaderProgram, const BonePaletteBuffer* palettes, size_t palette) const {
+	submitRecursive(queue, shaderProgram, palettes, palette);
+}
+
+/**
+ * @brief Queues the object's meshes and its children's, recursively, with the same model matrices
+ * renderRecursive would use.
+ */
+void Object3D::submitRecursive(RenderQueue& queue, ShaderProgram& shaderProgram, const BonePaletteBuffer* palettes,
+	size_t palette) const {
+	const glm::mat4& model = getWorldMatrix();
+	for (auto& mesh : m_meshes) {
+		queue.add(shaderProgram, mesh, model, palettes, palette);
+	}
+	for (auto& child : m_children) {
+		child.submitRecursive(queue, shaderProgram, palettes, palette);
+	}
+}
+
+void Object3D::collectMeshes(std::vector<MeshInstance>& instances) const {
+	const glm::mat4& model = getWorldMatrix();
+	for (auto& mesh : m_meshes) {
+		instances.push_back(MeshInstance{ &mesh, model });
+	}
+	for (auto& child : m_children) {
+		child.collectMeshes(instances);
 	}
 }
 
@@ -140,14 +280,14 @@ void Object3D::tick(float_t dt) {
 	}
 	auto acceleration = total_force / mass;
 	velocity += acceleration * dt;
-	m_position += velocity * dt;
-
 	rotational_velocity += rotational_acceleration * dt;
-	m_orientation += rotational_velocity * dt;
+	auto& hierarchy = TransformHierarchy::shared();
+	uint32_t transform = ensureTransform();
+	hierarchy.setPosition(transform, hierarchy.getPosition(transform) + velocity * dt);
+	hierarchy.setOrientation(transform, hierarchy.getOrientation(transform) + rotational_velocity * dt);
 
 	//std::cout << forces_list.size() << "\n";
 	forces_list.clear();
-	rebuildModelMatrix();
 }
 
 void Object3D::addForce(const glm::vec3& force) {
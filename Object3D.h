@@ -3,10 +3,25 @@
 #include <vector>
 #include "Mesh3D.h"
 #include "ShaderProgram.h"
+#include "TransformHierarchy.h"
+
+class BonePaletteBuffer;
+class RenderQueue;
+
+/**
+ * @brief A mesh of an object hierarchy with the model matrix it is drawn with.
+ */
+struct MeshInstance {
+	const Mesh3D* mesh;
+	glm::mat4 model;
+};
+
 /**
  * @brief Represents an object placed in a 3D scene. The object is a node in an hierarchy of
  * objects representing a single 3D model. Each object in the hierarchy has its own position,
  * orientation, and scale, by which it uniformly transforms a list of meshes in the object.
+ * The transforms themselves live in the shared TransformHierarchy, which the object holds a
+ * handle into; moving an object hands its transform over, copying one makes new transforms.
 */
 class Object3D {
 private:
@@ -14,15 +29,8 @@ private:
 	std::vector<Mesh3D> m_meshes;
 	std::vector<Object3D> m_children;
 
-	// The object's position, orientation, and scale in world space.
-	glm::vec3 m_position;
-	glm::vec3 m_orientation;
-	glm::vec3 m_scale;
-	glm::vec3 m_center;
-
-	// The object's cached local->world transformation matrix.
-	glm::mat4 m_modelMatrix;
-	glm::mat4 m_baseTransform;
+	// The object's position, orientation, scale and matrices in the TransformHierarchy.
+	uint32_t m_transform = TransformHierarchy::NO_TRANSFORM;
 
 	// Some objects from Assimp imports have a "name" field, useful for debugging.
 	std::string m_name;
@@ -37,21 +45,32 @@ private:
 	// Object mass
 	float_t mass;
 
-	// Recomputes the local->world transformation matrix.
-	void rebuildModelMatrix();
+	// Gets the object's transform, creating one if it has none.
+	uint32_t ensureTransform();
+	// Makes the object's transform the parent of its children's.
+	void adoptChildren();
 
 public:
 	// No default constructor; you must have a mesh to initialize an object.
+	// (An object made this way, like one moved from, has no transform until it is changed or
+	// given a child; until then it reads as an unmoved root.)
 	Object3D() {};
 	Object3D(std::vector<Mesh3D>&& meshes);
 	Object3D(std::vector<Mesh3D>&& meshes, const glm::mat4& baseTransform);
+	Object3D(const Object3D& other);
+	Object3D(Object3D&& other) noexcept;
+	Object3D& operator=(const Object3D& other);
+	Object3D& operator=(Object3D&& other) noexcept;
+	~Object3D();
 
 	// Simple accessors.
-	const glm::vec3& getPosition() const;
-	const glm::vec3& getOrientation() const;
-	const glm::vec3& getScale() const;
-	const glm::vec3& getCenter() const;
+	glm::vec3 getPosition() const;
+	glm::vec3 getOrientation() const;
+	glm::vec3 getScale() const;
+	glm::vec3 getCenter() const;
 	const std::string& getName() const;
+	// The object's local->world matrix, its parents' transforms included.
+	const glm::mat4& getWorldMatrix() const;
 
 	// Child management.
 	size_t numberOfChildren() const;
@@ -70,10 +89,17 @@ public:
 	void rotate(const glm::vec3& rotation);
 	void grow(const glm::vec3& growth);
 	void addChild(Object3D&& child);
+	// Makes room for count children, so adding them allocates once.
+	void reserveChildren(size_t count);
 
-	// Rendering.
+	// Rendering; world matrices come from the TransformHierarchy, updated first if anything moved.
 	void render(sf::RenderWindow& window, ShaderProgram& shaderProgram) const;
-	void renderRecursive(sf::RenderWindow& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const;
+	void renderRecursive(sf::RenderWindow& window, ShaderProgram& shaderProgram) const;
+	// Queues the object and its children instead of drawing them; skinned objects give their bone palette.
+	void submit(RenderQueue& queue, ShaderProgram& shaderProgram, const BonePaletteBuffer* palettes = nullptr, size_t palette = 0) const;
+	void submitRecursive(RenderQueue& queue, ShaderProgram& shaderProgram, const BonePaletteBuffer* palettes, size_t palette) const;
+	// Appends the meshes of the object and its children, depth first, with their model matrices.
+	void collectMeshes(std::vector<MeshInstance>& instances) const;
 
 	// tick
 	void tick(float_t dt);
@@ -0,0 +1,100 @@
+#pragma once
+
+/* Blending of local-space bone poses, done before the hierarchy pass composes them */
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "AnimationTracks.h"
+
+/**
+ * @brief Composes a pose into its T * R * S matrix.
+ */
+inline glm::mat4 ComposeLocalPose(const LocalPose& pose)
+{
+	glm::mat4 transform = glm::mat4_cast(pose.rotation);
+	transform[0] *= pose.scale.x;
+	transform[1] *= pose.scale.y;
+	transform[2] *= pose.scale.z;
+	transform[3] = glm::vec4(pose.translation, 1.0f);
+	return transform;
+}
+
+/**
+ * @brief Splits a T * R * S matrix without shear, such as a bind-pose node transform, into a pose.
+ */
+inline LocalPose DecomposeLocalPose(const glm::mat4& transform)
+{
+	LocalPose pose;
+	pose.translation = glm::vec3(transform[3]);
+	pose.scale = glm::vec3(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+		glm::length(glm::vec3(transform[2])));
+
+	glm::mat3 rotation(glm::vec3(transform[0]) / pose.scale.x, glm::vec3(transform[1]) / pose.scale.y,
+		glm::vec3(transform[2]) / pose.scale.z);
+	// A mirrored basis has a negative determinant; fold the reflection into the scale.
+	if (glm::determinant(rotation) < 0.0f)
+	{
+		pose.scale.x = -pose.scale.x;
+		rotation[0] = -rotation[0];
+	}
+	pose.rotation = glm::normalize(glm::quat_cast(rotation));
+	return pose;
+}
+
+/**
+ * @brief Blends count poses from a towards b by weight (0 keeps a): lerp for translation and
+ * scale, shortest-arc nlerp for rotation. out may alias a or b.
+ */
+inline void BlendPoses(const LocalPose* a, const LocalPose* b, float weight, LocalPose* out, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		glm::quat to = b[i].rotation;
+		if (glm::dot(a[i].rotation, to) < 0.0f)
+			to = -to;
+
+		out[i].translation = glm::mix(a[i].translation, b[i].translation, weight);
+		out[i].rotation = glm::normalize(glm::quat(
+			a[i].rotation.w + (to.w - a[i].rotation.w) * weight,
+			a[i].rotation.x + (to.x - a[i].rotation.x) * weight,
+			a[i].rotation.y + (to.y - a[i].rotation.y) * weight,
+			a[i].rotation.z + (to.z - a[i].rotation.z) * weight));
+		out[i].scale = glm::mix(a[i].scale, b[i].scale, weight);
+	}
+}
+
+/**
+ * @brief Layers count additive poses onto base poses with the given weight. An additive pose is
+ * the difference between a pose and its reference, see SubtractPoses. out may alias base.
+ */
+inline void AddPoses(const LocalPose* base, const LocalPose* additive, float weight, LocalPose* out, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		// Weight the difference as an nlerp from the identity rotation, which has w = 1.
+		glm::quat delta = additive[i].rotation;
+		if (delta.w < 0.0f)
+			delta = -delta;
+		delta = glm::normalize(glm::quat(1.0f + (delta.w - 1.0f) * weight,
+			delta.x * weight, delta.y * weight, delta.z * weight));
+
+		out[i].translation = base[i].translation + additive[i].translation * weight;
+		out[i].rotation = glm::normalize(delta * base[i].rotation);
+		out[i].scale = base[i].scale * glm::mix(glm::vec3(1.0f), additive[i].scale, weight);
+	}
+}
+
+/**
+ * @brief Gets the additive difference of count poses from their reference poses, so that
+ * AddPoses(reference, difference, 1) gives back the poses.
+ */
+inline void SubtractPoses(const LocalPose* poses, const LocalPose* reference, LocalPose* out, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		out[i].translation = poses[i].translation - reference[i].translation;
+		out[i].rotation = glm::normalize(poses[i].rotation * glm::inverse(reference[i].rotation));
+		out[i].scale = poses[i].scale / reference[i].scale;
+	}
+}
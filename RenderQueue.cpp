@@ -0,0 +1,138 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cassert>
+#include "AssetCache.h"
+
+// Bits of each state in a packet's sort key, from the top.
+constexpr int PROGRAM_BITS = 8;
+constexpr int PALETTE_BITS = 8;
+constexpr int TEXTURE_SET_BITS = 24;
+constexpr int VERTEX_ARRAY_BITS = 24;
+
+constexpr uint32_t UNKNOWN_TEXTURE = UINT32_MAX;
+
+/**
+ * @brief Fits a state index to its field of the sort key. An index too large for the field
+ * would spill into the next one and scramble the sort, so it is an error; release builds keep
+ * the low bits, which at worst splits a state group.
+ */
+static uint64_t s_keyField(uint32_t index, int bits) {
+	assert(index < (1ull << bits) && "too many distinct states for the RenderQueue sort key");
+	return index & ((1ull << bits) - 1);
+}
+
+uint32_t RenderQueue::programIndex(ShaderProgram* program) {
+	auto found = std::find(m_programs.begin(), m_programs.end(), program);
+	if (found != m_programs.end()) {
+		return static_cast<uint32_t>(found - m_programs.begin());
+	}
+	m_programs.push_back(program);
+	return static_cast<uint32_t>(m_programs.size() - 1);
+}
+
+uint32_t RenderQueue::paletteIndex(const BonePaletteBuffer* palettes, size_t palette) {
+	// Index 0 is left for meshes without a palette.
+	if (palettes == nullptr) {
+		return 0;
+	}
+	auto entry = std::make_pair(palettes, palette);
+	auto found = std::find(m_palettes.begin(), m_palettes.end(), entry);
+	if (found != m_palettes.end()) {
+		return static_cast<uint32_t>(found - m_palettes.begin()) + 1;
+	}
+	m_palettes.push_back(entry);
+	return static_cast<uint32_t>(m_palettes.size());
+}
+
+uint32_t RenderQueue::textureSetIndex(const std::vector<Texture>& textures) {
+	// Layers of one texture array share a set: they bind the same texture, and the layer is a uniform.
+	uint64_t hash = textures.size();
+	for (auto& texture : textures) {
+		hash = hashCombine(hash, texture.textureId);
+		hash = hashCombine(hash, hashBytes(texture.samplerName.data(), texture.samplerName.size()));
+	}
+	return m_textureSets.emplace(hash, static_cast<uint32_t>(m_textureSets.size())).first->second;
+}
+
+void RenderQueue::add(ShaderProgram& program, const Mesh3D& mesh, const glm::mat4& model,
+	const BonePaletteBuffer* palettes, size_t palette) {
+	uint64_t key = s_keyField(programIndex(&program), PROGRAM_BITS);
+	key = (key << PALETTE_BITS) | s_keyField(paletteIndex(palettes, palette), PALETTE_BITS);
+	key = (key << TEXTURE_SET_BITS) | s_keyField(textureSetIndex(mesh.getTextures()), TEXTURE_SET_BITS);
+	// vertex array names only order draws within a state group; any low bits do
+	key = (key << VERTEX_ARRAY_BITS) | (mesh.getVertexArray() & ((1u << VERTEX_ARRAY_BITS) - 1));
+	m_packets.push_back(DrawPacket{ key, &program, &mesh, palettes, palette, model });
+}
+
+void RenderQueue::flush() {
+	m_stats = RenderQueueStats();
+	std::vector<uint64_t> uploadsBefore;
+	for (auto program : m_programs) {
+		uploadsBefore.push_back(program->getUniformUploadCount());
+	}
+
+	// Stable, so draws with equal state keep the order they were queued in.
+	std::stable_sort(m_packets.begin(), m_packets.end(),
+		[](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+
+	// State left by the previous draw; nothing is known about what ran before the flush.
+	ShaderProgram* program = nullptr;
+	uint32_t vertexArray = UINT32_MAX;
+	const BonePaletteBuffer* palettes = nullptr;
+	size_t palette = 0;
+	std::vector<uint32_t> boundTextures;
+
+	for (auto& packet : m_packets) {
+		if (packet.program != program) {
+			program = packet.program;
+			program->activate();
+			m_stats.programChanges++;
+		}
+		const MeshUniforms& uniforms = program->getMeshUniforms();
+
+		if (packet.palettes != nullptr && (packet.palettes != palettes || packet.palette != palette)) {
+			palettes = packet.palettes;
+			palette = packet.palette;
+			palettes->bind(palette);
+			m_stats.paletteBinds++;
+		}
+		program->setUniform(uniforms.skeletal, packet.palettes != nullptr);
+
+		uint32_t meshVertexArray = packet.mesh->getVertexArray();
+		if (meshVertexArray != vertexArray) {
+			vertexArray = meshVertexArray;
+			GeometryPool::shared().bindVertexArray(packet.mesh->getGeometry());
+			m_stats.vertexArrayChanges++;
+		}
+
+		const std::vector<Texture>& textures = packet.mesh->getTextures();
+		if (boundTextures.size() < textures.size()) {
+			boundTextures.resize(textures.size(), UNKNOWN_TEXTURE);
+		}
+		Mesh3D::setTextureUniforms(*program, textures);
+		for (int i = 0; i < static_cast<int>(textures.size()); i++) {
+			if (boundTextures[i] != textures[i].textureId) {
+				boundTextures[i] = textures[i].textureId;
+				glActiveTexture(GL_TEXTURE0 + i);
+				glBindTexture(textures[i].target(), textures[i].textureId);
+				m_stats.textureBinds++;
+			}
+		}
+		program->setUniform(uniforms.model, packet.model);
+
+		const GeometryRange& geometry = packet.mesh->getGeometry();
+		glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(geometry.indexCount), geometry.indexType,
+			geometry.indexOffset(), geometry.baseVertex);
+		m_stats.draws++;
+	}
+	glBindVertexArray(0);
+
+	for (size_t i = 0; i < m_programs.size(); i++) {
+		m_stats.uniformUploads += static_cast<int>(m_programs[i]->getUniformUploadCount() - uploadsBefore[i]);
+	}
+
+	m_packets.clear();
+	m_programs.clear();
+	m_palettes.clear();
+	m_textureSets.clear();
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BonePaletteBuffer.h"
+#include "Mesh3D.h"
+#include "ShaderProgram.h"
+
+/**
+ * @brief What a RenderQueue did in its last flush.
+ */
+struct RenderQueueStats {
+	int draws = 0;
+	int programChanges = 0;
+	int vertexArrayChanges = 0;
+	int textureBinds = 0;
+	int paletteBinds = 0;
+	// uniform values that reached OpenGL; redundant sets are filtered by ShaderProgram
+	int uniformUploads = 0;
+
+	int stateChanges() const { return programChanges + vertexArrayChanges + textureBinds + paletteBinds; }
+
+	RenderQueueStats& operator+=(const RenderQueueStats& other) {
+		draws += other.draws;
+		programChanges += other.programChanges;
+		vertexArrayChanges += other.vertexArrayChanges;
+		textureBinds += other.textureBinds;
+		paletteBinds += other.paletteBinds;
+		uniformUploads += other.uniformUploads;
+		return *this;
+	}
+};
+
+/**
+ * @brief Collects the draws of a frame or pass, then issues them sorted by render state so that
+ * draws sharing a program, bone palette, texture set or vertex array run back to back, and skips
+ * every bind that would not change the state left by the previous draw.
+ */
+class RenderQueue {
+private:
+	struct DrawPacket {
+		// program, palette, texture set and vertex array, most expensive to change first
+		uint64_t key;
+		ShaderProgram* program;
+		const Mesh3D* mesh;
+		const BonePaletteBuffer* palettes;
+		size_t palette;
+		glm::mat4 model;
+	};
+
+	std::vector<DrawPacket> m_packets;
+	// the distinct programs, palettes and texture sets of the queued packets, by order of first use
+	std::vector<ShaderProgram*> m_programs;
+	std::vector<std::pair<const BonePaletteBuffer*, size_t>> m_palettes;
+	std::unordered_map<uint64_t, uint32_t> m_textureSets;
+	RenderQueueStats m_stats;
+
+	uint32_t programIndex(ShaderProgram* program);
+	uint32_t paletteIndex(const BonePaletteBuffer* palettes, size_t palette);
+	uint32_t textureSetIndex(const std::vector<Texture>& textures);
+
+public:
+	/**
+	 * @brief Queues a mesh to be drawn with program and model matrix; skinned meshes also give
+	 * the palette uploaded for them this frame.
+	 */
+	void add(ShaderProgram& program, const Mesh3D& mesh, const glm::mat4& model,
+		const BonePaletteBuffer* palettes = nullptr, size_t palette = 0);
+
+	/**
+	 * @brief Draws everything queued since the last flush, in state order, and empties the queue.
+	 * Per-pass uniforms such as view or lightPos must already be set on the programs.
+	 */
+	void flush();
+
+	const RenderQueueStats& getStats() const { return m_stats; }
+};
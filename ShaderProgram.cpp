@@ -1,16 +1,140 @@
 #include "ShaderProgram.h"
+#include "AssetCache.h"
 #include <glad/glad.h>
+#include <SFML/Window/Context.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
 ShaderProgram::ShaderProgram()
-    : m_programId(-1) {
+    : m_programId(-1), m_uniformUploads(0) {
 
 }
 
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+/**
+ * @brief The program binary entry points (GL 4.1 / ARB_get_program_binary). The GL 3.3 loader
+ * does not provide them, so they are looked up from the current context on first use.
+ */
+struct ProgramBinaryApi {
+    typedef void (APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (APIENTRYP ProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteri)(GLuint program, GLenum pname, GLint value);
+
+    GetProgramBinary getProgramBinary = nullptr;
+    ProgramBinary programBinary = nullptr;
+    ProgramParameteri programParameteri = nullptr;
+    bool hasFormats = false;
+
+    bool isAvailable() const { return getProgramBinary && programBinary && programParameteri && hasFormats; }
+};
+
+static const ProgramBinaryApi& s_programBinaryApi()
+{
+    static ProgramBinaryApi api = [] {
+        ProgramBinaryApi loaded;
+        loaded.getProgramBinary = reinterpret_cast<ProgramBinaryApi::GetProgramBinary>(sf::Context::getFunction("glGetProgramBinary"));
+        loaded.programBinary = reinterpret_cast<ProgramBinaryApi::ProgramBinary>(sf::Context::getFunction("glProgramBinary"));
+        loaded.programParameteri = reinterpret_cast<ProgramBinaryApi::ProgramParameteri>(sf::Context::getFunction("glProgramParameteri"));
+        // Some drivers expose the functions but support no binary format at all.
+        GLint formats = 0;
+        if (loaded.getProgramBinary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        loaded.hasFormats = formats > 0;
+        return loaded;
+    }();
+    return api;
+}
+
+/**
+ * @brief Keys a program binary by its shader sources and by the driver that produced it;
+ * binaries are only valid for the exact driver build that wrote them.
+ */
+static uint64_t s_programCacheKey(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
+{
+    uint64_t key = hashCombine(hashFile(vertexPath), hashFile(fragmentPath));
+    key = hashCombine(key, geometryPath != nullptr ? hashFile(geometryPath) : 0);
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        const char* text = reinterpret_cast<const char*>(glGetString(name));
+        key = hashCombine(key, text != nullptr ? hashBytes(text, std::strlen(text)) : 0);
+    }
+    return key;
+}
+
+/**
+ * @brief Loads a cached binary into program. Fails, leaving program to be built from source,
+ * if there is no cache entry or the driver rejects the binary (e.g. after a driver update).
+ */
+static bool s_loadProgramBinary(uint32_t program, const char* vertexPath, uint64_t key)
+{
+    const ProgramBinaryApi& api = s_programBinaryApi();
+    if (!api.isAvailable())
+        return false;
+
+    MappedFile file(assetCachePath(vertexPath, "program", key));
+    BinaryReader reader(nullptr, 0);
+    if (!openAssetCache(file, "program", key, reader))
+        return false;
+    GLenum format = reader.read<GLenum>();
+    std::vector<char> binary;
+    reader.readVector(binary);
+    if (reader.failed() || binary.empty())
+        return false;
+
+    api.programBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success != 0;
+}
+
+static void s_saveProgramBinary(uint32_t program, const char* vertexPath, uint64_t key)
+{
+    const ProgramBinaryApi& api = s_programBinaryApi();
+    if (!api.isAvailable())
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    api.getProgramBinary(program, length, &length, &format, binary.data());
+    binary.resize(length);
+
+    BinaryWriter writer;
+    beginAssetCache(writer, "program", key);
+    writer.write(format);
+    writer.writeVector(binary);
+    if (!writer.saveTo(assetCachePath(vertexPath, "program", key)))
+        std::cout << "WARNING: could not write program binary cache for " << vertexPath << std::endl;
+}
+
 void ShaderProgram::load(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
 {
+    auto start = std::chrono::steady_clock::now();
+    // 0. reuse the program linked by a previous run, if the sources and driver are unchanged
+    uint64_t cacheKey = s_programCacheKey(vertexPath, fragmentPath, geometryPath);
+    m_programId = glCreateProgram();
+    if (s_loadProgramBinary(m_programId, vertexPath, cacheKey))
+    {
+        introspectUniforms();
+        std::cout << "Shader program " << vertexPath << " loaded from binary cache in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+        return;
+    }
+    glDeleteProgram(m_programId);
+
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
     std::string fragmentCode;
@@ -103,12 +227,14 @@ void ShaderProgram::load(const char* vertexPath, const char* fragmentPath, const
     glAttachShader(m_programId, fragment);
     if (geometryPath != nullptr)
         glAttachShader(m_programId, geometry);
+    if (s_programBinaryApi().isAvailable())
+        s_programBinaryApi().programParameteri(m_programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(m_programId);
-    // print compile errors if any
-    glGetShaderiv(m_programId, GL_COMPILE_STATUS, &success);
+    // print link errors if any
+    glGetProgramiv(m_programId, GL_LINK_STATUS, &success);
     if (!success)
     {
-        glGetShaderInfoLog(m_programId, 512, NULL, infoLog);
+        glGetProgramInfoLog(m_programId, 512, NULL, infoLog);
         throw std::runtime_error(infoLog);
     };
     // delete the shaders as they're linked into our program now and no longer necessary
@@ -117,6 +243,81 @@ void ShaderProgram::load(const char* vertexPath, const char* fragmentPath, const
     if (geometryPath != nullptr)
         glDeleteShader(geometry);
 
+    s_saveProgramBinary(m_programId, vertexPath, cacheKey);
+    introspectUniforms();
+    std::cout << "Shader program " << vertexPath << " compiled in "
+        << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+}
+
+void ShaderProgram::introspectUniforms()
+{
+    m_uniforms.clear();
+    m_uniformIndex.clear();
+
+    GLint count = 0, maxNameLength = 0;
+    glGetProgramiv(m_programId, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint arraySize = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_programId, i, static_cast<GLsizei>(nameBuffer.size()), &length, &arraySize, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+
+        // Arrays are reported as "name[0]"; every element gets its own slot.
+        std::string baseName = name;
+        if (baseName.size() > 3 && baseName.compare(baseName.size() - 3, 3, "[0]") == 0)
+            baseName.resize(baseName.size() - 3);
+
+        for (GLint element = 0; element < arraySize; element++)
+        {
+            std::string elementName = arraySize > 1 || baseName != name
+                ? baseName + "[" + std::to_string(element) + "]" : name;
+            GLint location = glGetUniformLocation(m_programId, elementName.c_str());
+            // Uniforms inside blocks have no location; they are set through buffers.
+            if (location < 0)
+                continue;
+
+            m_uniformIndex[elementName] = static_cast<int32_t>(m_uniforms.size());
+            if (element == 0)
+                m_uniformIndex[baseName] = static_cast<int32_t>(m_uniforms.size());
+            m_uniforms.push_back(UniformSlot{ location, 0, {} });
+        }
+    }
+
+    m_meshUniforms.model = getUniformHandle("model");
+    m_meshUniforms.hasNormalMap = getUniformHandle("hasNormalMap");
+    m_meshUniforms.hasSpecularMap = getUniformHandle("hasSpecularMap");
+    m_meshUniforms.baseTexture = getUniformHandle("baseTexture");
+    m_meshUniforms.baseTextureArray = getUniformHandle("baseTextureArray");
+    m_meshUniforms.baseTextureLayer = getUniformHandle("baseTextureLayer");
+    m_meshUniforms.normalMap = getUniformHandle("normalMap");
+    m_meshUniforms.specularMap = getUniformHandle("specularMap");
+    m_meshUniforms.skeletal = getUniformHandle("skeletal");
+    m_meshUniforms.indirect = getUniformHandle("indirect");
+}
+
+UniformHandle ShaderProgram::getUniformHandle(const std::string& uniformName) const
+{
+    auto found = m_uniformIndex.find(uniformName);
+    return UniformHandle{ found == m_uniformIndex.end() ? -1 : found->second };
+}
+
+template <typename Upload>
+void ShaderProgram::setCached(UniformHandle handle, const void* value, uint32_t size, Upload upload)
+{
+    if (!handle.isValid())
+        return;
+    UniformSlot& slot = m_uniforms[handle.index];
+    if (slot.size == size && std::memcmp(slot.value, value, size) == 0)
+        return;
+    std::memcpy(slot.value, value, size);
+    slot.size = size;
+    upload(slot.location);
+    m_uniformUploads++;
 }
 
 void ShaderProgram::activate()
@@ -124,47 +325,92 @@ void ShaderProgram::activate()
     glUseProgram(m_programId);
 }
 
+void ShaderProgram::setUniform(UniformHandle uniform, bool value)
+{
+    setUniform(uniform, (int32_t)value);
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, int32_t value)
+{
+    setCached(uniform, &value, sizeof(value), [&](GLint location) { glUniform1i(location, value); });
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, float_t value)
+{
+    setCached(uniform, &value, sizeof(value), [&](GLint location) { glUniform1f(location, value); });
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::vec2& value)
+{
+    setCached(uniform, &value[0], sizeof(value), [&](GLint location) { glUniform2fv(location, 1, &value[0]); });
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::vec3& value)
+{
+    setCached(uniform, &value[0], sizeof(value), [&](GLint location) { glUniform3fv(location, 1, &value[0]); });
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::vec4& value)
+{
+    setCached(uniform, &value[0], sizeof(value), [&](GLint location) { glUniform4fv(location, 1, &value[0]); });
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::mat2& value)
+{
+    setCached(uniform, &value[0][0], sizeof(value), [&](GLint location) { glUniformMatrix2fv(location, 1, false, &value[0][0]); });
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::mat3& value)
+{
+    setCached(uniform, &value[0][0], sizeof(value), [&](GLint location) { glUniformMatrix3fv(location, 1, false, &value[0][0]); });
+}
+
+void ShaderProgram::setUniform(UniformHandle uniform, const glm::mat4& value)
+{
+    setCached(uniform, &value[0][0], sizeof(value), [&](GLint location) { glUniformMatrix4fv(location, 1, false, &value[0][0]); });
+}
+
 void ShaderProgram::setUniform(const std::string& uniformName, bool value)
 {
-    glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), (int32_t)value);
+    setUniform(getUniformHandle(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, int32_t value)
 {
-    glUniform1i(glGetUniformLocation(m_programId, uniformName.c_str()), value);
+    setUniform(getUniformHandle(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, float_t value)
 {
-    glUniform1f(glGetUniformLocation(m_programId, uniformName.c_str()), value);
+    setUniform(getUniformHandle(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec2& value)
 {
-    glUniform2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    setUniform(getUniformHandle(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec3& value)
 {
-    glUniform3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    setUniform(getUniformHandle(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::vec4& value)
 {
-    glUniform4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, &value[0]);
+    setUniform(getUniformHandle(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat2& value)
 {
-    glUniformMatrix2fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    setUniform(getUniformHandle(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat3& value)
 {
-    glUniformMatrix3fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    setUniform(getUniformHandle(uniformName), value);
 }
 
 void ShaderProgram::setUniform(const std::string& uniformName, const glm::mat4& value)
 {
-    glUniformMatrix4fv(glGetUniformLocation(m_programId, uniformName.c_str()), 1, false, &value[0][0]);
+    setUniform(getUniformHandle(uniformName), value);
 }
@@ -1,14 +1,86 @@
 #pragma once
 #include <glm/ext.hpp>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief A uniform of one ShaderProgram, resolved once by name. Setting a uniform through a
+ * handle involves no string hashing; a handle to a uniform the program lacks is ignored.
+ */
+struct UniformHandle {
+	int32_t index = -1;
+
+	bool isValid() const { return index >= 0; }
+};
+
+/**
+ * @brief Handles to the uniforms Object3D and Mesh3D set for every draw, resolved when the
+ * program is loaded. A program without one of them gets an invalid handle.
+ */
+struct MeshUniforms {
+	UniformHandle model;
+	UniformHandle hasNormalMap;
+	UniformHandle hasSpecularMap;
+	UniformHandle baseTexture;
+	UniformHandle baseTextureArray;
+	UniformHandle baseTextureLayer;
+	UniformHandle normalMap;
+	UniformHandle specularMap;
+	UniformHandle skeletal;
+	UniformHandle indirect;
+};
+
 class ShaderProgram {
 	uint32_t m_programId;
 
+	// A uniform found by introspection, with the last value uploaded to it.
+	struct UniformSlot {
+		int32_t location;
+		uint32_t size;
+		float value[16];
+	};
+
+	std::vector<UniformSlot> m_uniforms;
+	std::unordered_map<std::string, int32_t> m_uniformIndex;
+	MeshUniforms m_meshUniforms;
+	uint64_t m_uniformUploads;
+
+	// Lists the program's active uniforms; array elements are indexed both as "name[i]" and, for the first, "name".
+	void introspectUniforms();
+
+	// Uploads a value unless it equals the last value uploaded to that uniform.
+	template <typename Upload>
+	void setCached(UniformHandle handle, const void* value, uint32_t size, Upload upload);
+
 public:
 	ShaderProgram();
 
 	void activate();
 
+	/**
+	 * @brief Resolves a uniform once, for hot paths that set it every frame.
+	 */
+	UniformHandle getUniformHandle(const std::string& uniformName) const;
+
+	inline const MeshUniforms& getMeshUniforms() const { return m_meshUniforms; }
+
+	/**
+	 * @brief Gets how many uniform values have reached OpenGL, not counting redundant sets.
+	 */
+	inline uint64_t getUniformUploadCount() const { return m_uniformUploads; }
+
+	// Like OpenGL uniforms, these apply to the program and expect it to be active.
+	void setUniform(UniformHandle uniform, bool value);
+	void setUniform(UniformHandle uniform, int32_t value);
+	void setUniform(UniformHandle uniform, float_t value);
+	void setUniform(UniformHandle uniform, const glm::vec2& value);
+	void setUniform(UniformHandle uniform, const glm::vec3& value);
+	void setUniform(UniformHandle uniform, const glm::vec4& value);
+	void setUniform(UniformHandle uniform, const glm::mat2& value);
+	void setUniform(UniformHandle uniform, const glm::mat3& value);
+	void setUniform(UniformHandle uniform, const glm::mat4& value);
+
 	void setUniform(const std::string& uniformName, bool value);
 	void setUniform(const std::string& uniformName, int32_t value);
 	void setUniform(const std::string& uniformName, float_t value);
@@ -1,55 +1,141 @@
 
 #include "Skeletal.h"
+#include "AssetCache.h"
 #include "AssimpGLMHelpers.h"
+#include "MeshOptimizer.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
 
 
 const size_t FLOATS_PER_VERTEX = 3;
 const size_t VERTICES_PER_FACE = 3;
 
-Skeletal::Skeletal(const std::string& path, bool flipTextureCoords) {
-	m_root = s_assimpLoad(path, flipTextureCoords);
+Skeletal::Skeletal(const std::string& path, bool flipTextureCoords, int boneInfluences)
+	: Skeletal(importModel(path, flipTextureCoords, boneInfluences)) {
 }
 
-std::vector<Texture> s_loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
+ImportedModel Skeletal::importModel(const std::string& path, bool flipTextureCoords, int boneInfluences) {
+	if (boneInfluences != 2 && boneInfluences != 4 && boneInfluences != 8) {
+		throw std::invalid_argument("Skeletal: bone influences per vertex must be 2, 4 or 8, not "
+			+ std::to_string(boneInfluences));
+	}
+	auto start = std::chrono::steady_clock::now();
+
+	ImportedModel imported;
+	imported.path = path;
+	// The cache is keyed by the source contents and the import options, so edited files are re-imported.
+	imported.sourceKey = hashCombine(hashCombine(hashFile(path), flipTextureCoords ? 1 : 0), boneInfluences);
+	imported.cached = loadCachedModel(path, imported.sourceKey, imported.model);
+	if (!imported.cached) {
+		Skeletal importer;
+		importer.m_BoneInfluences = boneInfluences;
+		imported.model = importer.s_assimpLoad(path, flipTextureCoords);
+		saveCachedModel(path, imported.sourceKey, imported.model);
+	}
+
+	// Textures another model already uploaded are skipped; the others are decoded, or read from
+	// the asset cache, on the shared ThreadPool.
+	// the layers of a texture array are conditioned together, for its first reference
+	imported.textureData.resize(imported.model.textures.size());
+	std::vector<size_t> textureLoads;
+	for (size_t i = 0; i < imported.model.textures.size(); i++) {
+		const TextureReference& texture = imported.model.textures[i];
+		if (TextureCache::shared().isResident(texture.path, texture.samplerName)) {
+			continue;
+		}
+		if (texture.arrayLayers.empty() || texture.layer == 0) {
+			textureLoads.push_back(i);
+		}
+	}
+	ThreadPool::shared().parallelFor(static_cast<int>(textureLoads.size()), 1, [&](int begin, int end) {
+		for (int load = begin; load < end; load++) {
+			size_t i = textureLoads[load];
+			const TextureReference& texture = imported.model.textures[i];
+			imported.textureData[i] = texture.arrayLayers.empty()
+				? loadTextureData(texture.path, texture.samplerName)
+				: loadTextureArrayData(texture.arrayLayers, texture.samplerName);
+		}
+	});
+
+	imported.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return imported;
+}
+
+Skeletal::Skeletal(ImportedModel&& imported) {
+	auto start = std::chrono::steady_clock::now();
+	ModelData& model = imported.model;
+	m_sourceKey = imported.sourceKey;
+	m_BoneInfoMap = model.boneInfoMap;
+	m_BoneCounter = model.boneCount;
+
+	// Upload every mesh once, and every texture no other model uploaded yet; nodes referring to
+	// the same mesh share its vertex array.
 	std::vector<Texture> textures;
+	for (size_t i = 0; i < model.textures.size(); i++) {
+		const TextureReference& texture = model.textures[i];
+		if (texture.arrayLayers.empty()) {
+			textures.push_back(TextureCache::shared().upload(texture.path, imported.textureData[i], texture.samplerName));
+		}
+		else {
+			textures.push_back(TextureCache::shared().uploadArray(texture.path, texture.arrayLayers, texture.layer,
+				imported.textureData[i], texture.samplerName));
+		}
+	}
+	std::vector<Mesh3D> meshes;
+	for (auto& mesh : model.meshes) {
+		std::vector<Texture> meshTextures;
+		for (int texture : mesh.textures) {
+			meshTextures.push_back(textures[texture]);
+		}
+		meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.faces), std::move(meshTextures));
+	}
+	std::vector<int> remainingUses(meshes.size(), 0);
+	for (auto& node : model.nodes) {
+		for (int mesh : node.meshes) {
+			remainingUses[mesh]++;
+		}
+	}
+	m_root = s_buildObject(model, 0, meshes, remainingUses);
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << imported.path << (imported.cached ? " loaded from cache in " : " imported in ") << imported.milliseconds
+		<< " ms, uploaded in " << elapsed << " ms\n";
+}
+
+std::vector<int> s_loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, const std::filesystem::path& modelPath,
+	ModelData& model) {
+	std::vector<int> textures;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
 		aiString name;
 		mat->GetTexture(type, i, &name);
-		std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
+		std::string texPath = (modelPath.parent_path() / name.C_Str()).string();
 
-		auto existing = loadedTextures.find(texPath);
-		if (existing != loadedTextures.end()) {
-			textures.push_back(existing->second);
+		auto existing = std::find_if(model.textures.begin(), model.textures.end(),
+			[&](const TextureReference& texture) { return texture.path == texPath; });
+		if (existing != model.textures.end()) {
+			textures.push_back(static_cast<int>(existing - model.textures.begin()));
 		}
 		else {
-			sf::Image image;
-			image.loadFromFile(texPath.string());
-			Texture tex = Texture::loadImage(image, typeName);
-			textures.push_back(tex);
-			loadedTextures.insert(std::make_pair(texPath, tex));
+			textures.push_back(static_cast<int>(model.textures.size()));
+			model.textures.push_back(TextureReference{ texPath, typeName, {}, -1 });
 		}
 	}
 	return textures;
 }
 
-void SetVertexBoneData(Vertex3D& vertex, int boneID, float weight)
-{
-	for (int i = 0; i < MAX_BONE_PER_VERTEX; ++i)
-	{
-		if (vertex.m_BoneIDs[i] < 0)
-		{
-			vertex.m_Weights[i] = weight;
-			vertex.m_BoneIDs[i] = boneID;
-			break;
-		}
-	}
-}
+struct BoneInfluence {
+	int boneID;
+	float weight;
+};
 
 void Skeletal::ExtractBoneWeightForVertices(std::vector<Vertex3D>& vertices, const aiMesh* mesh, const aiScene* scene)
 {
+	// Gather every influence first; which ones to keep is only known once a vertex has them all.
+	std::vector<std::vector<BoneInfluence>> influences(vertices.size());
 	for (int boneIndex = 0; boneIndex < mesh->mNumBones; ++boneIndex)
 	{
 		int boneID = -1;
@@ -75,14 +161,59 @@ void Skeletal::ExtractBoneWeightForVertices(std::vector<Vertex3D>& vertices, con
 		{
 			int vertexId = weights[weightIndex].mVertexId;
 			float weight = weights[weightIndex].mWeight;
-			assert(vertexId <= vertices.size());
-			SetVertexBoneData(vertices[vertexId], boneID, weight);
+			assert(static_cast<size_t>(vertexId) < vertices.size());
+			if (weight > 0.0f)
+			{
+				influences[vertexId].push_back(BoneInfluence{ boneID, weight });
+			}
 		}
 	}
+
+	// Keep the heaviest influences, heaviest first so the shaders can stop at the first empty slot,
+	// and renormalize them so the vertex is not pulled toward the model's origin.
+	size_t truncated = 0;
+	size_t mostInfluences = 0;
+	float largestDropped = 0.0f;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		auto& vertexInfluences = influences[i];
+		std::stable_sort(vertexInfluences.begin(), vertexInfluences.end(),
+			[](const BoneInfluence& a, const BoneInfluence& b) { return a.weight > b.weight; });
+		mostInfluences = std::max(mostInfluences, vertexInfluences.size());
+
+		size_t kept = std::min(vertexInfluences.size(), static_cast<size_t>(m_BoneInfluences));
+		float total = 0.0f;
+		float dropped = 0.0f;
+		for (size_t j = 0; j < vertexInfluences.size(); ++j)
+		{
+			if (j < kept)
+				total += vertexInfluences[j].weight;
+			else
+				dropped += vertexInfluences[j].weight;
+		}
+		if (kept < vertexInfluences.size())
+		{
+			truncated++;
+			largestDropped = std::max(largestDropped, dropped / (total + dropped));
+		}
+
+		for (size_t j = 0; j < kept; ++j)
+		{
+			vertices[i].m_BoneIDs[j] = vertexInfluences[j].boneID;
+			vertices[i].m_Weights[j] = vertexInfluences[j].weight / total;
+		}
+	}
+
+	if (truncated > 0)
+	{
+		std::cout << "  mesh " << mesh->mName.C_Str() << ": " << truncated << " of " << vertices.size()
+			<< " vertices had more than " << m_BoneInfluences << " bone influences (up to " << mostInfluences
+			<< "), dropping at most " << largestDropped * 100.0f << "% of a vertex's weight\n";
+	}
 }
 
-Mesh3D Skeletal::s_fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
+MeshData Skeletal::s_fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
+	ModelData& model) {
 	std::vector<Vertex3D> vertices;
 
 	for (size_t i = 0; i < mesh->mNumVertices; i++) {
@@ -116,69 +247,112 @@ Mesh3D Skeletal::s_fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, cons
 		faces.push_back(mesh->mFaces[i].mIndices[2]);
 	}
 
-	std::vector<Texture> textures = {};
+	std::vector<int> textures = {};
 	if (mesh->mMaterialIndex >= 0)
 	{
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuseMaps = s_loadMaterialTextures(material,
-			aiTextureType_DIFFUSE, "baseTexture", modelPath, loadedTextures);
+		std::vector<int> diffuseMaps = s_loadMaterialTextures(material,
+			aiTextureType_DIFFUSE, "baseTexture", modelPath, model);
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		std::vector<Texture> specularMaps = s_loadMaterialTextures(material,
-			aiTextureType_SPECULAR, "specularMap", modelPath, loadedTextures);
+		std::vector<int> specularMaps = s_loadMaterialTextures(material,
+			aiTextureType_SPECULAR, "specularMap", modelPath, model);
 		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		std::vector<Texture> normalMaps = s_loadMaterialTextures(material,
-			aiTextureType_HEIGHT, "normalMap", modelPath, loadedTextures);
+		std::vector<int> normalMaps = s_loadMaterialTextures(material,
+			aiTextureType_HEIGHT, "normalMap", modelPath, model);
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 		normalMaps = s_loadMaterialTextures(material,
-			aiTextureType_NORMALS, "normalMap", modelPath, loadedTextures);
+			aiTextureType_NORMALS, "normalMap", modelPath, model);
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 	}
 
 	// add:bones - ExtractBoneWeightForVertices
 	ExtractBoneWeightForVertices(vertices, mesh, scene);
 
-	auto m = Mesh3D(std::move(vertices), std::move(faces), std::move(textures));
-	return m;
+	return MeshData{ std::move(vertices), std::move(faces), std::move(textures) };
 }
 
-Object3D Skeletal::s_processAssimpNode(aiNode* node, const aiScene* scene,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures) {
-
-	// Load the aiNode's meshes.
-	std::vector<Mesh3D> meshes;
-	for (auto i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.emplace_back(s_fromAssimpMesh(mesh, scene, modelPath, loadedTextures));
-	}
+void Skeletal::s_processAssimpNode(aiNode* node, ModelData& model) {
+	// Nodes are appended depth-first; grab the index first, since recursing grows model.nodes.
+	int index = static_cast<int>(model.nodes.size());
+	model.nodes.emplace_back();
 
-	std::vector<Texture> textures;
-	for (auto& p : loadedTextures) {
-		textures.push_back(p.second);
-	}
 	glm::mat4 baseTransform;
 	for (auto i = 0; i < 4; i++) {
 		for (auto j = 0; j < 4; j++) {
 			baseTransform[i][j] = node->mTransformation[j][i];
 		}
 	}
-	auto parent = Object3D(std::move(meshes), baseTransform);
+	model.nodes[index].transformation = baseTransform;
+
+	for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+		model.nodes[index].meshes.push_back(node->mMeshes[i]);
+	}
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		model.nodes[index].children.push_back(static_cast<int>(model.nodes.size()));
+		s_processAssimpNode(node->mChildren[i], model);
+	}
+}
+
+Object3D Skeletal::s_buildObject(const ModelData& model, int nodeIndex, std::vector<Mesh3D>& meshes,
+	std::vector<int>& remainingUses) {
+	const ModelNodeData& node = model.nodes[nodeIndex];
+
+	// Load the node's meshes.
+	std::vector<Mesh3D> nodeMeshes;
+	nodeMeshes.reserve(node.meshes.size());
+	for (int mesh : node.meshes) {
+		if (--remainingUses[mesh] == 0) {
+			nodeMeshes.push_back(std::move(meshes[mesh]));
+		}
+		else {
+			nodeMeshes.push_back(meshes[mesh]);
+		}
+	}
+	auto parent = Object3D(std::move(nodeMeshes), node.transformation);
 
-	for (auto i = 0; i < node->mNumChildren; i++) {
-		Object3D child = s_processAssimpNode(node->mChildren[i], scene, modelPath, loadedTextures);
-		parent.addChild(std::move(child));
+	parent.reserveChildren(node.children.size());
+	for (int child : node.children) {
+		parent.addChild(s_buildObject(model, child, meshes, remainingUses));
 	}
 
 	return parent;
 }
 
-Object3D Skeletal::s_assimpLoad(const std::string& path, bool flipTextureCoords) {
+/**
+ * @brief Packs a model's base textures into the layers of one texture array, so all of its meshes
+ * draw with a single texture bound, each sampling its own layer. Models with one base texture keep it.
+ */
+static void s_packTextureArrays(ModelData& model, const std::string& path) {
+	std::vector<std::string> layers;
+	for (auto& texture : model.textures) {
+		if (texture.samplerName == "baseTexture") {
+			layers.push_back(texture.path);
+		}
+	}
+	if (layers.size() < 2) {
+		return;
+	}
+
+	int layer = 0;
+	for (auto& texture : model.textures) {
+		if (texture.samplerName == "baseTexture") {
+			texture.path = path + "#baseTexture";
+			texture.arrayLayers = layers;
+			texture.layer = layer++;
+		}
+	}
+	std::cout << "  packed " << layers.size() << " base textures into one texture array\n";
+}
+
+ModelData Skeletal::s_assimpLoad(const std::string& path, bool flipTextureCoords) {
 
 	std::cout << path << "\n";
 
 	Assimp::Importer importer;
 	// add: calculate tangent
-	auto options = aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_CalcTangentSpace;
+	// Bone weights are limited by ExtractBoneWeightForVertices instead, to a configurable count.
+	auto options = (aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_CalcTangentSpace) & ~aiProcess_LimitBoneWeights;
 	if (flipTextureCoords) {
 		options |= aiProcess_FlipUVs;
 	}
@@ -190,9 +364,26 @@ Object3D Skeletal::s_assimpLoad(const std::string& path, bool flipTextureCoords)
 
 	}
 
-	std::vector<Mesh3D> meshes;
-	std::unordered_map<std::filesystem::path, Texture> loadedTextures;
+	ModelData model;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+		model.meshes.push_back(s_fromAssimpMesh(scene->mMeshes[i], scene, std::filesystem::path(path), model));
+	}
+
+	// Reorder triangles and vertices for the GPU's vertex cache, overdraw and vertex fetch.
+	VertexCacheStats before;
+	VertexCacheStats after;
+	for (auto& mesh : model.meshes) {
+		before += analyzeVertexCache(mesh.faces.data(), mesh.faces.size(), mesh.vertices.size());
+		optimizeMesh(mesh.vertices, mesh.faces);
+		after += analyzeVertexCache(mesh.faces.data(), mesh.faces.size(), mesh.vertices.size());
+	}
+	std::cout << "  vertex cache: ACMR " << before.acmr() << " -> " << after.acmr()
+		<< ", ATVR " << before.atvr() << " -> " << after.atvr() << "\n";
+	s_processAssimpNode(scene->mRootNode, model);
+	s_packTextureArrays(model, path);
 
-	auto ret = s_processAssimpNode(scene->mRootNode, scene, std::filesystem::path(path), loadedTextures);
-	return ret;
-}
\ No newline at end of file
+	// The bone map filled while reading the meshes' weights.
+	model.boneInfoMap = m_BoneInfoMap;
+	model.boneCount = m_BoneCounter;
+	return model;
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "BoneInfo.h"
+#include "ModelData.h"
 #include "Object3D.h"
+#include "TextureData.h"
 #include <unordered_map>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -9,29 +11,88 @@
 #include <unordered_map>
 #include <algorithm>
 
+/**
+ * @brief Bone influences kept per vertex when a model is imported, unless told otherwise.
+ */
+constexpr int DEFAULT_BONE_INFLUENCES = 4;
+
+/**
+ * @brief A model read from disk and decoded, but not uploaded to OpenGL yet.
+ */
+struct ImportedModel {
+	std::string path;
+	uint64_t sourceKey = 0;
+	bool cached = false;
+	ModelData model;
+	// the conditioned mip chains of model.textures, in the same order; empty for those the
+	// TextureCache held
+	std::vector<TextureData> textureData;
+	double milliseconds = 0.0;
+};
+
 class Skeletal
 {
 public:
-	Skeletal(const std::string& path, bool flipTextureCoords);
+	/**
+	 * @brief Imports a model, keeping the boneInfluences (2, 4 or 8) heaviest bone influences of
+	 * each vertex, sorted by decreasing weight and renormalized to sum to one.
+	 */
+	Skeletal(const std::string& path, bool flipTextureCoords, int boneInfluences = DEFAULT_BONE_INFLUENCES);
+
+	/**
+	 * @brief Uploads an imported model's textures and meshes; needs the OpenGL context.
+	 */
+	explicit Skeletal(ImportedModel&& imported);
+
+	/**
+	 * @brief Does all of the constructor's work that does not need OpenGL: reads the model from
+	 * the asset cache or imports it with Assimp, and decodes its textures. Safe to call from any
+	 * thread.
+	 */
+	static ImportedModel importModel(const std::string& path, bool flipTextureCoords,
+		int boneInfluences = DEFAULT_BONE_INFLUENCES);
 
 	Object3D& getRoot() { return m_root; }
 
+	/**
+	 * @brief Moves the model's hierarchy out, for a scene to own; the model is left with an
+	 * empty root that has no transform.
+	 */
+	Object3D takeRoot() { return std::move(m_root); }
+
 	auto& GetBoneInfoMap() { return m_BoneInfoMap; }
 	int& GetBoneCount() { return m_BoneCounter; }
 
+	// Identifies the imported contents (source file and import options), used to key derived caches.
+	uint64_t GetSourceKey() const { return m_sourceKey; }
+
 private:
 	Object3D m_root;
 	std::unordered_map<std::string, BoneInfo> m_BoneInfoMap;
 	int m_BoneCounter = 0;
+	int m_BoneInfluences = DEFAULT_BONE_INFLUENCES;
+	uint64_t m_sourceKey = 0;
+
+	// Only for importModel, which uses the bone map while reading the meshes.
+	Skeletal() = default;
+
+	ModelData s_assimpLoad(const std::string& path, bool flipTextureCoords);
 
-	Object3D s_assimpLoad(const std::string& path, bool flipTextureCoords);
+	void s_processAssimpNode(aiNode* node, ModelData& model);
 
-	Object3D s_processAssimpNode(aiNode* node, const aiScene* scene,
-		const std::filesystem::path& modelPath,
-		std::unordered_map<std::filesystem::path, Texture>& loadedTextures);
+	MeshData s_fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
+		ModelData& model);
 
-	Mesh3D s_fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-		std::unordered_map<std::filesystem::path, Texture>& loadedTextures);
+	/**
+	 * @brief Builds a node's Object3D and its children's. A mesh is moved into the last node that
+	 * uses it (remainingUses counts the others) and copied into the rest.
+	 */
+	Object3D s_buildObject(const ModelData& model, int nodeIndex, std::vector<Mesh3D>& meshes,
+		std::vector<int>& remainingUses);
 
+	/**
+	 * @brief Fills the vertices' bone slots with their m_BoneInfluences heaviest influences and
+	 * reports how many vertices had to drop some.
+	 */
 	void ExtractBoneWeightForVertices(std::vector<Vertex3D>& vertices, const aiMesh* mesh, const aiScene* scene);
 };
@@ -1,115 +1,194 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <map>
 #include <glm/glm.hpp>
 #include <assimp/scene.h>
-#include "Bone.h"
+#include "AnimationTracks.h"
+#include "AssimpGLMHelpers.h"
 #include "BoneInfo.h"
-#include "Skeletal.h"
 
-struct AssimpNodeData
+/*
+ * One node of the skeleton hierarchy. Nodes are stored flattened in depth-first order, so a
+ * node's parent always comes before it and a pose can be composed in a single forward pass.
+ */
+struct SkeletonNode
 {
+	/*bind-pose local transform, used when a clip has no track for this node*/
 	glm::mat4 transformation;
-	std::string name;
-	int childrenCount;
-	std::vector<AssimpNodeData> children;
+
+	/*index of the parent node, -1 for the root*/
+	int parent;
+
+	/*slot in the final bone matrices, -1 if no vertex is skinned to this node*/
+	int paletteIndex;
+
+	/*BoneInfo::offset of the palette slot*/
+	glm::mat4 offset;
 };
 
+/*
+ * The hierarchy and bone map of an animation file, resolved once against the model and shared
+ * by every clip in the file.
+ */
+struct AnimationSkeleton
+{
+	std::vector<SkeletonNode> nodes;
+	/*node names, indexed like nodes*/
+	std::vector<std::string> names;
+	/*each node's transformation as a pose, for blending nodes a clip does not animate*/
+	std::vector<LocalPose> bindPose;
+	std::unordered_map<std::string, BoneInfo> boneInfoMap;
+};
+
+/*
+ * Clip data loaded once and only read afterwards, so one instance can be shared by any number
+ * of SkeletalAnimators; all playback state lives in the animators. Clips are created by a
+ * SkeletalAnimationLibrary, which owns the skeleton they share.
+ */
 class SkeletalAnimation
 {
 public:
 	SkeletalAnimation() = default;
 
-	SkeletalAnimation(const std::string& animationPath, Skeletal* model)
+	SkeletalAnimation(const aiAnimation* animation, std::shared_ptr<const AnimationSkeleton> skeleton)
+		: m_Name(animation->mName.data), m_Skeleton(std::move(skeleton))
 	{
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(animationPath, aiProcessPreset_TargetRealtime_MaxQuality);
-		assert(scene && scene->mRootNode);
-
-		std::cout << "Animation count: " << scene->mNumAnimations << "\n";
-
-		auto animation = scene->mAnimations[0];
-
 		m_Duration = animation->mDuration;
 		m_TicksPerSecond = animation->mTicksPerSecond;
-		ReadHierarchyData(m_RootNode, scene->mRootNode);
-		ReadMissingBones(animation, *model);
-
-		std::cout << "Bone count: " << model->GetBoneCount() << "\n";
+		for (unsigned int i = 0; i < animation->mNumChannels; i++)
+			ReadTrack(animation->mChannels[i]);
+		ResolveNodeTracks();
 	}
 
 	~SkeletalAnimation()
 	{
 	}
 
-	Bone* FindBone(const std::string& name)
+	/**
+	 * @brief Gets the index of the named bone's key tracks, or -1 if the clip does not animate it.
+	 */
+	int FindBoneIndex(const std::string& name) const
 	{
-		auto iter = std::find_if(m_Bones.begin(), m_Bones.end(),
-			[&](const Bone& Bone)
-			{
-				return Bone.GetBoneName() == name;
-			}
-		);
-		if (iter == m_Bones.end()) return nullptr;
-		else return &(*iter);
+		return m_Tracks.FindTrack(name);
 	}
 
-	inline float GetTicksPerSecond() { return m_TicksPerSecond; }
-	inline float GetDuration() { return m_Duration; }
-	inline const AssimpNodeData& GetRootNode() { return m_RootNode; }
-	inline const std::unordered_map<std::string, BoneInfo>& GetBoneIDMap()
+	inline const AnimationTracks& GetTracks() const { return m_Tracks; }
+
+	/**
+	 * @brief Compresses the clip's key tracks in place and prints the memory saved and the error
+	 * introduced. Call it right after loading, before any SkeletalAnimator plays the clip.
+	 */
+	TrackCompressionReport Compress(const TrackCompressionSettings& settings)
 	{
-		return m_BoneInfoMap;
+		TrackCompressionReport report = m_Tracks.Compress(settings);
+
+		std::cout << "Animation keys: " << report.keysBefore << " -> " << report.keysAfter
+			<< ", memory: " << report.bytesBefore / 1024 << " KB -> " << report.bytesAfter / 1024 << " KB\n";
+		std::cout << "Animation max error: position " << report.maxPositionError
+			<< ", rotation " << report.maxRotationError << " rad, scale " << report.maxScaleError << "\n";
+		return report;
 	}
 
-	inline int getBonesSize() { return m_Bones.size(); }
+	inline const std::string& GetName() const { return m_Name; }
+	inline float GetTicksPerSecond() const { return m_TicksPerSecond; }
+	inline float GetDuration() const { return m_Duration; }
+	inline const std::vector<SkeletonNode>& GetSkeleton() const { return m_Skeleton->nodes; }
+	inline const std::vector<LocalPose>& GetBindPose() const { return m_Skeleton->bindPose; }
 
-private:
-	void ReadMissingBones(const aiAnimation* animation, Skeletal& model)
+	/**
+	 * @brief Gets the clip's track for every skeleton node, -1 where the clip does not animate it.
+	 */
+	inline const std::vector<int>& GetNodeTracks() const { return m_NodeTracks; }
+
+	inline const std::unordered_map<std::string, BoneInfo>& GetBoneIDMap() const
 	{
-		int size = animation->mNumChannels;
+		return m_Skeleton->boneInfoMap;
+	}
 
-		auto& boneInfoMap = model.GetBoneInfoMap();//getting m_BoneInfoMap from Model class
-		int& boneCount = model.GetBoneCount(); //getting the m_BoneCounter from Model class
+	inline int getBonesSize() const { return m_Tracks.GetTrackCount(); }
 
-		//reading channels(bones engaged in an animation and their keyframes)
-		for (int i = 0; i < size; i++)
-		{
-			auto channel = animation->mChannels[i];
-			std::string boneName = channel->mNodeName.data;
-
-			if (boneInfoMap.find(boneName) == boneInfoMap.end())
-			{
-				boneInfoMap[boneName].id = boneCount;
-				boneCount++;
-			}
-			m_Bones.push_back(Bone(channel->mNodeName.data,
-				boneInfoMap[channel->mNodeName.data].id, channel));
-		}
+	/**
+	 * @brief Tells whether the other clip poses the same skeleton nodes in the same order, so the
+	 * poses of the two can be blended node by node.
+	 */
+	bool HasSameSkeleton(const SkeletalAnimation& other) const
+	{
+		return m_Skeleton == other.m_Skeleton || m_Skeleton->names == other.m_Skeleton->names;
+	}
 
-		m_BoneInfoMap = boneInfoMap;
+	/**
+	 * @brief Attaches the clip to another skeleton, matching its tracks to the skeleton's nodes by
+	 * name; nodes the clip does not animate keep their bind pose.
+	 */
+	void BindSkeleton(std::shared_ptr<const AnimationSkeleton> skeleton)
+	{
+		m_Skeleton = std::move(skeleton);
+		ResolveNodeTracks();
 	}
 
-	void ReadHierarchyData(AssimpNodeData& dest, const aiNode* src)
+	template <typename Writer>
+	void Write(Writer& writer) const
 	{
-		assert(src);
+		writer.writeString(m_Name);
+		writer.write(m_Duration);
+		writer.write(m_TicksPerSecond);
+		m_Tracks.Write(writer);
+	}
 
-		dest.name = src->mName.data;
-		dest.transformation = AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation);
+	/**
+	 * @brief Restores a clip written by Write and attaches it to the skeleton of its file.
+	 */
+	template <typename Reader>
+	void Read(Reader& reader, std::shared_ptr<const AnimationSkeleton> skeleton)
+	{
+		m_Name = reader.readString();
+		m_Duration = reader.template read<float>();
+		m_TicksPerSecond = reader.template read<int>();
+		m_Tracks.Read(reader);
+		m_Skeleton = std::move(skeleton);
+		ResolveNodeTracks();
+	}
+
+private:
+	void ReadTrack(const aiNodeAnim* channel)
+	{
+		std::vector<KeyPosition> positions(channel->mNumPositionKeys);
+		for (size_t positionIndex = 0; positionIndex < positions.size(); ++positionIndex)
+		{
+			positions[positionIndex].position = AssimpGLMHelpers::GetGLMVec(channel->mPositionKeys[positionIndex].mValue);
+			positions[positionIndex].timeStamp = channel->mPositionKeys[positionIndex].mTime;
+		}
 
-		dest.childrenCount = src->mNumChildren;
+		std::vector<KeyRotation> rotations(channel->mNumRotationKeys);
+		for (size_t rotationIndex = 0; rotationIndex < rotations.size(); ++rotationIndex)
+		{
+			rotations[rotationIndex].orientation = AssimpGLMHelpers::GetGLMQuat(channel->mRotationKeys[rotationIndex].mValue);
+			rotations[rotationIndex].timeStamp = channel->mRotationKeys[rotationIndex].mTime;
+		}
 
-		for (int i = 0; i < src->mNumChildren; i++)
+		std::vector<KeyScale> scales(channel->mNumScalingKeys);
+		for (size_t keyIndex = 0; keyIndex < scales.size(); ++keyIndex)
 		{
-			AssimpNodeData newData;
-			ReadHierarchyData(newData, src->mChildren[i]);
-			dest.children.push_back(newData);
+			scales[keyIndex].scale = AssimpGLMHelpers::GetGLMVec(channel->mScalingKeys[keyIndex].mValue);
+			scales[keyIndex].timeStamp = channel->mScalingKeys[keyIndex].mTime;
 		}
+
+		m_Tracks.AddTrack(channel->mNodeName.data, positions, rotations, scales);
 	}
+
+	void ResolveNodeTracks()
+	{
+		m_NodeTracks.resize(m_Skeleton->names.size());
+		for (size_t i = 0; i < m_NodeTracks.size(); i++)
+			m_NodeTracks[i] = FindBoneIndex(m_Skeleton->names[i]);
+	}
+
+	std::string m_Name;
 	float m_Duration;
 	int m_TicksPerSecond;
-	std::vector<Bone> m_Bones;
-	AssimpNodeData m_RootNode;
-	std::unordered_map<std::string, BoneInfo> m_BoneInfoMap;
-};
\ No newline at end of file
+	AnimationTracks m_Tracks;
+	std::vector<int> m_NodeTracks;
+	std::shared_ptr<const AnimationSkeleton> m_Skeleton;
+};
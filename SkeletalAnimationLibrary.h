@@ -0,0 +1,241 @@
+#pragma once
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <assimp/scene.h>
+#include <assimp/Importer.hpp>
+#include "AssetCache.h"
+#include "PoseBlending.h"
+#include "SkeletalAnimation.h"
+#include "Skeletal.h"
+
+/*
+ * Every clip of an animation file, imported once. The clips share one skeleton, resolved against
+ * the model's bone map, and are addressed by index (file order) or by name. Libraries of the same
+ * model can share the first one's skeleton, so their clips can be blended with each other.
+ */
+class SkeletalAnimationLibrary
+{
+public:
+	SkeletalAnimationLibrary(const std::string& animationPath, Skeletal* model,
+		const SkeletalAnimationLibrary* shareSkeletonWith = nullptr, const TrackCompressionSettings* compression = nullptr)
+		: SkeletalAnimationLibrary(animationPath, model->GetBoneInfoMap(), model->GetBoneCount(), shareSkeletonWith,
+			compression)
+	{
+	}
+
+	/**
+	 * @brief Loads the clips against a bare bone map, without a model or a GL context; bones the
+	 * map lacks are added to it, as with a model. Given another library of the same model, the
+	 * clips are bound to its skeleton (by node name) instead of the file's own. Given compression
+	 * settings, the clips are compressed (see SkeletalAnimation::Compress) before they are cached,
+	 * so a load from the cache needs no compressing. Throws
+	 * std::runtime_error with the importer's message if the file cannot be imported.
+	 */
+	SkeletalAnimationLibrary(const std::string& animationPath, std::unordered_map<std::string, BoneInfo>& boneInfoMap,
+		int& boneCount, const SkeletalAnimationLibrary* shareSkeletonWith = nullptr,
+		const TrackCompressionSettings* compression = nullptr)
+	{
+		auto start = std::chrono::steady_clock::now();
+		auto skeleton = std::make_shared<AnimationSkeleton>();
+
+		// The clips do not depend on the model: bones are mapped to palette slots on every load.
+		// Compressed clips are cached apart from uncompressed ones, and by their tolerances.
+		uint64_t key = hashFile(animationPath);
+		if (compression)
+		{
+			for (float tolerance : { compression->positionTolerance, compression->rotationTolerance, compression->scaleTolerance })
+			{
+				uint32_t bits;
+				std::memcpy(&bits, &tolerance, sizeof(bits));
+				key = hashCombine(key, bits);
+			}
+		}
+		bool cached = LoadCached(animationPath, key, skeleton);
+		if (!cached)
+		{
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(animationPath, aiProcessPreset_TargetRealtime_MaxQuality);
+			if (!scene || !scene->mRootNode)
+				throw std::runtime_error("could not import animations from " + animationPath + ": "
+					+ importer.GetErrorString());
+
+			std::cout << "Animation count: " << scene->mNumAnimations << "\n";
+
+			ReadHierarchyData(scene->mRootNode, -1, *skeleton);
+			for (unsigned int i = 0; i < scene->mNumAnimations; i++)
+				m_Clips.emplace_back(scene->mAnimations[i], skeleton);
+			if (compression)
+				Compress(*compression);
+			SaveCached(animationPath, key, *skeleton);
+		}
+		ReadMissingBones(boneInfoMap, boneCount, *skeleton);
+		ResolvePalette(*skeleton);
+		m_Skeleton = skeleton;
+		if (shareSkeletonWith)
+		{
+			m_Skeleton = shareSkeletonWith->m_Skeleton;
+			for (auto& clip : m_Clips)
+				clip.BindSkeleton(m_Skeleton);
+		}
+
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << animationPath << (cached ? " loaded from cache in " : " imported in ") << elapsed << " ms\n";
+		std::cout << "Bone count: " << boneCount << "\n";
+	}
+
+	SkeletalAnimationLibrary(const SkeletalAnimationLibrary&) = delete;
+	SkeletalAnimationLibrary& operator=(const SkeletalAnimationLibrary&) = delete;
+
+	inline int GetClipCount() const { return static_cast<int>(m_Clips.size()); }
+
+	/**
+	 * @brief Gets a clip by its index in the file; throws std::out_of_range if the file has no such
+	 * clip (a file without animations has none at all).
+	 */
+	const SkeletalAnimation& GetClip(int index) const
+	{
+		if (index < 0 || index >= GetClipCount())
+			throw std::out_of_range("animation clip " + std::to_string(index) + " requested from a file with "
+				+ std::to_string(m_Clips.size()) + " clips");
+		return m_Clips[index];
+	}
+
+	/**
+	 * @brief Gets the first clip with the given name, or nullptr if the file has none.
+	 */
+	const SkeletalAnimation* FindClip(const std::string& name) const
+	{
+		for (auto& clip : m_Clips)
+		{
+			if (clip.GetName() == name)
+				return &clip;
+		}
+		return nullptr;
+	}
+
+	inline const AnimationSkeleton& GetSkeleton() const { return *m_Skeleton; }
+
+	/**
+	 * @brief Compresses every clip, see SkeletalAnimation::Compress, for a library loaded without
+	 * compression settings. Call it right after loading; the cache keeps the uncompressed clips.
+	 */
+	void Compress(const TrackCompressionSettings& settings)
+	{
+		for (auto& clip : m_Clips)
+			clip.Compress(settings);
+	}
+
+private:
+	void ReadHierarchyData(const aiNode* src, int parent, AnimationSkeleton& skeleton)
+	{
+		assert(src);
+
+		SkeletonNode node;
+		node.transformation = AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation);
+		node.parent = parent;
+		node.paletteIndex = -1;
+
+		int index = static_cast<int>(skeleton.nodes.size());
+		skeleton.nodes.push_back(node);
+		skeleton.names.push_back(src->mName.data);
+
+		for (unsigned int i = 0; i < src->mNumChildren; i++)
+			ReadHierarchyData(src->mChildren[i], index, skeleton);
+	}
+
+	void ReadMissingBones(std::unordered_map<std::string, BoneInfo>& boneInfoMap, int& boneCount, AnimationSkeleton& skeleton)
+	{
+		//bones engaged in any clip that no vertex is skinned to still get a palette slot
+		for (auto& clip : m_Clips)
+		{
+			const AnimationTracks& tracks = clip.GetTracks();
+			for (int i = 0; i < tracks.GetTrackCount(); i++)
+			{
+				const std::string& boneName = tracks.GetTrackName(i);
+				if (boneInfoMap.find(boneName) == boneInfoMap.end())
+				{
+					boneInfoMap[boneName].id = boneCount;
+					boneCount++;
+				}
+			}
+		}
+
+		skeleton.boneInfoMap = boneInfoMap;
+	}
+
+	/**
+	 * @brief Points every skeleton node at its slot in the model's final bone matrices, and
+	 * decomposes its bind pose.
+	 */
+	void ResolvePalette(AnimationSkeleton& skeleton)
+	{
+		skeleton.bindPose.resize(skeleton.nodes.size());
+		for (size_t i = 0; i < skeleton.nodes.size(); i++)
+		{
+			skeleton.bindPose[i] = DecomposeLocalPose(skeleton.nodes[i].transformation);
+
+			SkeletonNode& node = skeleton.nodes[i];
+			node.paletteIndex = -1;
+
+			auto boneInfo = skeleton.boneInfoMap.find(skeleton.names[i]);
+			if (boneInfo != skeleton.boneInfoMap.end())
+			{
+				node.paletteIndex = boneInfo->second.id;
+				node.offset = boneInfo->second.offset;
+			}
+		}
+	}
+
+	bool LoadCached(const std::string& animationPath, uint64_t key, const std::shared_ptr<AnimationSkeleton>& skeleton)
+	{
+		MappedFile file(assetCachePath(animationPath, "clips", key));
+		BinaryReader reader(nullptr, 0);
+		if (!openAssetCache(file, "clips", key, reader))
+			return false;
+
+		reader.readVector(skeleton->nodes);
+		uint64_t nameCount = reader.read<uint64_t>();
+		for (uint64_t i = 0; i < nameCount && !reader.failed(); i++)
+			skeleton->names.push_back(reader.readString());
+
+		uint64_t clipCount = reader.read<uint64_t>();
+		for (uint64_t i = 0; i < clipCount && !reader.failed() && skeleton->names.size() == skeleton->nodes.size(); i++)
+		{
+			m_Clips.emplace_back();
+			m_Clips.back().Read(reader, skeleton);
+		}
+
+		if (reader.failed() || skeleton->nodes.empty() || skeleton->names.size() != skeleton->nodes.size())
+		{
+			*skeleton = AnimationSkeleton();
+			m_Clips.clear();
+			return false;
+		}
+		return true;
+	}
+
+	void SaveCached(const std::string& animationPath, uint64_t key, const AnimationSkeleton& skeleton) const
+	{
+		BinaryWriter writer;
+		beginAssetCache(writer, "clips", key);
+		writer.writeVector(skeleton.nodes);
+		writer.write(static_cast<uint64_t>(skeleton.names.size()));
+		for (auto& name : skeleton.names)
+			writer.writeString(name);
+
+		writer.write(static_cast<uint64_t>(m_Clips.size()));
+		for (auto& clip : m_Clips)
+			clip.Write(writer);
+
+		if (!writer.saveTo(assetCachePath(animationPath, "clips", key)))
+			std::cout << "WARNING: could not write asset cache for " << animationPath << std::endl;
+	}
+
+	std::vector<SkeletalAnimation> m_Clips;
+	std::shared_ptr<const AnimationSkeleton> m_Skeleton;
+};
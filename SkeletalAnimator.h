@@ -1,89 +1,470 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
-#include "SkeletalAnimation.h"
-#include "Bone.h"
+#include "PoseBlending.h"
+#include "SkeletalAnimationLibrary.h"
 
-class SkeletalAnimator
+/*
+ * Read-only view of a bone palette: one final bone matrix per slot of the model's bone map.
+ */
+struct BonePalette
 {
-public:
-	SkeletalAnimator(SkeletalAnimation* animation)
-	{
-		m_CurrentTime = 0.0;
-		m_CurrentAnimation = animation;
-		
-		int size = 300;
+	const glm::mat4* matrices;
+	int count;
 
-		m_FinalBoneMatrices.reserve(size);
+	inline int size() const { return count; }
+	inline const glm::mat4& operator[](int i) const { return matrices[i]; }
+	inline const glm::mat4* begin() const { return matrices; }
+	inline const glm::mat4* end() const { return matrices + count; }
+};
 
-		for (int i = 0; i < size; i++)
-			m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+/*
+ * One point of a 1D blend space: the clip that plays at a parameter value, such as a speed.
+ */
+struct BlendSpaceSample
+{
+	const SkeletalAnimation* clip;
+	float position;
+};
 
-		m_GlobalInverseTransform = inverse(m_CurrentAnimation->GetRootNode().transformation);
+/*
+ * Per-instance playback of shared SkeletalAnimations: clip times, a key cursor per bone track
+ * and the resulting bone palette. Animators never write into the clips, so several of them can
+ * play (and be updated concurrently on) the same SkeletalAnimation.
+ *
+ * The base pose comes from a single clip or a 1D blend space, can cross-fade to another one and
+ * can have additive layers on top. All blending is done on local TRS poses, so however many
+ * clips contribute, the hierarchy is composed once. Every clip played by an animator must use
+ * the same skeleton layout (see SkeletalAnimation::HasSameSkeleton); blending clips of another
+ * layout throws std::invalid_argument.
+ */
+class SkeletalAnimator
+{
+public:
+	SkeletalAnimator(const SkeletalAnimation* animation)
+	{
+		m_FrontPalette = 0;
+		m_FadeTime = 0.0f;
+		m_FadeDuration = 0.0f;
+		PlayAnimation(animation);
 	}
 
 	void UpdateAnimation(float dt)
 	{
 		m_DeltaTime = dt;
-		if (m_CurrentAnimation)
+		if (m_Source.playbacks.empty())
+			return;
+
+		AdvanceSource(m_Source, dt);
+		if (IsFading())
 		{
-			m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt;
-			m_CurrentTime = fmod(m_CurrentTime, m_CurrentAnimation->GetDuration());
-			CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
+			AdvanceSource(m_FadeSource, dt);
+			m_FadeTime += dt;
+			if (m_FadeTime >= m_FadeDuration)
+				m_FadeSource = PoseSource();
 		}
+		for (auto& layer : m_Layers)
+			AdvancePlayback(layer.playback, dt * layer.playback.clip->GetTicksPerSecond());
+
+		CalculateBoneTransform();
+		m_FrontPalette ^= 1;
+	}
+
+	/**
+	 * @brief Switches to the clip at once, dropping any cross-fade in progress.
+	 */
+	void PlayAnimation(const SkeletalAnimation* pAnimation)
+	{
+		PlayBlendSpace({ BlendSpaceSample{ pAnimation, 0.0f } }, 0.0f);
 	}
 
-	void PlayAnimation(SkeletalAnimation* pAnimation)
+	/**
+	 * @brief Fades from whatever plays now to the clip, starting it from the beginning, over
+	 * duration seconds. Interrupting a fade continues from its target and drops its source.
+	 */
+	void CrossFade(const SkeletalAnimation* pAnimation, float duration)
 	{
-		m_CurrentAnimation = pAnimation;
-		m_CurrentTime = 0.0f;
+		PlayBlendSpace({ BlendSpaceSample{ pAnimation, 0.0f } }, duration);
 	}
 
-	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+	/**
+	 * @brief Plays a 1D blend space: the two samples around the blend parameter are blended and
+	 * kept in phase, so an idle/walk/run space by speed keeps the feet in step. Fades to it over
+	 * fadeDuration seconds, 0 switches at once.
+	 */
+	void PlayBlendSpace(std::vector<BlendSpaceSample> samples, float fadeDuration)
 	{
-		std::string nodeName = node->name;
-		glm::mat4 nodeTransform = node->transformation;
+		assert(!samples.empty());
+		std::sort(samples.begin(), samples.end(),
+			[](const BlendSpaceSample& a, const BlendSpaceSample& b) { return a.position < b.position; });
 
-		Bone* Bone = m_CurrentAnimation->FindBone(nodeName);
+		bool fading = fadeDuration > 0.0f && !m_Source.playbacks.empty();
+		const SkeletalAnimation& clip = *samples[0].clip;
+		for (auto& sample : samples)
+			CheckSkeleton(clip, *sample.clip);
+		if (fading)
+			CheckSkeleton(clip, *m_Source.samples[0].clip);
+		for (auto& layer : m_Layers)
+			CheckSkeleton(clip, *layer.playback.clip);
 
-		if (Bone)
+		float parameter = m_Source.parameter;
+		if (fading)
 		{
-			Bone->Update(m_CurrentTime);
-			nodeTransform = Bone->GetLocalTransform();
+			m_FadeSource = std::move(m_Source);
+			m_FadeTime = 0.0f;
+			m_FadeDuration = fadeDuration;
 		}
+		else
+		{
+			m_FadeSource = PoseSource();
+		}
+
+		m_Source = PoseSource();
+		m_Source.samples = std::move(samples);
+		m_Source.parameter = parameter;
+		for (auto& sample : m_Source.samples)
+		{
+			m_Source.playbacks.emplace_back();
+			StartPlayback(m_Source.playbacks.back(), sample.clip);
+		}
+
+		ResizePalettes(&clip);
+		ResetUndrivenSlots();
+		m_GlobalInverseTransform = inverse(clip.GetSkeleton()[0].transformation);
+	}
+
+	/**
+	 * @brief Sets the value, such as a speed, at which the current blend space is evaluated.
+	 */
+	void SetBlendParameter(float parameter)
+	{
+		m_Source.parameter = parameter;
+	}
 
-		glm::mat4 globalTransformation = parentTransform * nodeTransform;
+	/**
+	 * @brief Adds a clip that plays in a loop on top of the base pose, as its difference from the
+	 * clip's first frame scaled by weight.
+	 * @return the layer's index for SetLayerWeight.
+	 */
+	int AddAdditiveLayer(const SkeletalAnimation* clip, float weight)
+	{
+		CheckSkeleton(*m_Source.samples[0].clip, *clip);
+		m_Layers.emplace_back();
+		AdditiveLayer& layer = m_Layers.back();
+		layer.weight = weight;
+		StartPlayback(layer.playback, clip);
+		ResizePalettes(clip);
 
-		const auto& boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-		if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+		layer.reference.resize(clip->GetSkeleton().size());
+		std::vector<BoneCursor> cursors(clip->getBonesSize());
+		SampleNodePoses(*clip, 0.0f, cursors, layer.reference);
+		return static_cast<int>(m_Layers.size()) - 1;
+	}
+
+	void SetLayerWeight(int layer, float weight)
+	{
+		m_Layers[layer].weight = weight;
+	}
+
+	void RemoveLayers()
+	{
+		m_Layers.clear();
+		ResetUndrivenSlots();
+	}
+
+	/**
+	 * @brief Composes the current pose in one pass over the flattened skeleton; parents precede
+	 * their children, so their global transforms are always ready. The result goes to the back
+	 * palette; UpdateAnimation publishes it.
+	 */
+	void CalculateBoneTransform()
+	{
+		const SkeletalAnimation& clip = *m_Source.samples[0].clip;
+		const auto& skeleton = clip.GetSkeleton();
+		m_GlobalTransforms.resize(skeleton.size());
+
+		// A lone clip skips the pose stage: its tracks are sampled straight into matrices.
+		if (m_Source.playbacks.size() == 1 && !IsFading() && m_Layers.empty())
+		{
+			ClipPlayback& playback = m_Source.playbacks[0];
+			const auto& nodeTracks = clip.GetNodeTracks();
+			m_LocalTransforms.resize(playback.cursors.size());
+			clip.GetTracks().SampleLocalTransforms(playback.time, playback.cursors.data(), m_LocalTransforms.data());
+
+			for (size_t i = 0; i < skeleton.size(); i++)
+			{
+				const glm::mat4& nodeTransform = nodeTracks[i] >= 0 ? m_LocalTransforms[nodeTracks[i]]
+					: skeleton[i].transformation;
+				ComposeNode(skeleton, static_cast<int>(i), nodeTransform);
+			}
+			return;
+		}
+
+		EvaluateSource(m_Source, m_NodePoses);
+		if (IsFading())
+		{
+			EvaluateSource(m_FadeSource, m_FadePoses);
+			assert(m_FadePoses.size() == skeleton.size());
+			float weight = m_FadeTime / m_FadeDuration;
+			BlendPoses(m_FadePoses.data(), m_NodePoses.data(), weight, m_NodePoses.data(), static_cast<int>(skeleton.size()));
+		}
+		for (auto& layer : m_Layers)
 		{
-			int index = boneInfoMap.at(nodeName).id;
-			m_FinalBoneMatrices[index] = m_GlobalInverseTransform * globalTransformation * boneInfoMap.at(nodeName).offset;
+			SampleNodePoses(*layer.playback.clip, layer.playback.time, layer.playback.cursors, m_FadePoses);
+			SubtractPoses(m_FadePoses.data(), layer.reference.data(), m_FadePoses.data(), static_cast<int>(skeleton.size()));
+			AddPoses(m_NodePoses.data(), m_FadePoses.data(), layer.weight, m_NodePoses.data(), static_cast<int>(skeleton.size()));
 		}
 
-		for (int i = 0; i < node->childrenCount; i++)
-			CalculateBoneTransform(&node->children[i], globalTransformation);
+		for (size_t i = 0; i < skeleton.size(); i++)
+			ComposeNode(skeleton, static_cast<int>(i), ComposeLocalPose(m_NodePoses[i]));
 	}
 
-	std::vector<glm::mat4> GetFinalBoneMatrices()
+	/**
+	 * @brief Gets the palette of the last completed update, without copying it. The view stays
+	 * valid and unchanged while the next update computes into the other buffer, so a renderer
+	 * may read it until that update after next.
+	 */
+	BonePalette GetFinalBoneMatrices() const
 	{
-		return m_FinalBoneMatrices;
+		const std::vector<glm::mat4>& palette = m_FinalBoneMatrices[m_FrontPalette];
+		return BonePalette{ palette.data(), static_cast<int>(palette.size()) };
 	}
 
 	void resetAnimation() {
-		m_CurrentTime = 0.0f;
-		for (int i = 0; i < m_FinalBoneMatrices.size(); i++)
-			m_FinalBoneMatrices[i] = glm::mat4(1.0);
+		for (auto& playback : m_Source.playbacks)
+			StartPlayback(playback, playback.clip);
+		m_Source.phase = 0.0f;
+		m_FadeSource = PoseSource();
+		for (auto& palette : m_FinalBoneMatrices)
+			palette.assign(palette.size(), glm::mat4(1.0));
 	}
 
 private:
-	std::vector<glm::mat4> m_FinalBoneMatrices;
-	SkeletalAnimation* m_CurrentAnimation;
-	float m_CurrentTime;
+	/*a clip being sampled: its time in ticks and a key cursor per track*/
+	struct ClipPlayback
+	{
+		const SkeletalAnimation* clip = nullptr;
+		float time = 0.0f;
+		std::vector<BoneCursor> cursors;
+	};
+
+	/*a single clip or a blend space, with the state of each of its clips*/
+	struct PoseSource
+	{
+		std::vector<BlendSpaceSample> samples;
+		std::vector<ClipPlayback> playbacks;
+		float parameter = 0.0f;
+		/*position in the cycle, 0 to 1, shared by all clips so they stay in step*/
+		float phase = 0.0f;
+	};
+
+	struct AdditiveLayer
+	{
+		ClipPlayback playback;
+		float weight;
+		/*the clip's first frame, which the layer adds the difference from*/
+		std::vector<LocalPose> reference;
+	};
+
+	static void StartPlayback(ClipPlayback& playback, const SkeletalAnimation* clip)
+	{
+		playback.clip = clip;
+		playback.time = 0.0f;
+		playback.cursors.assign(clip->getBonesSize(), BoneCursor());
+	}
+
+	/**
+	 * @brief Advances a playback by a number of ticks and wraps it. A clip of no duration stays at 0.
+	 */
+	static void AdvancePlayback(ClipPlayback& playback, float ticks)
+	{
+		float duration = playback.clip->GetDuration();
+		playback.time = duration > 0.0f ? fmod(playback.time + ticks, duration) : 0.0f;
+	}
+
+	/**
+	 * @brief Finds the two samples around the blend parameter and the weight of the second.
+	 */
+	static void FindBlendSamples(const PoseSource& source, int& first, int& second, float& weight)
+	{
+		const auto& samples = source.samples;
+		first = second = 0;
+		weight = 0.0f;
+		if (source.parameter <= samples.front().position)
+			return;
+		if (source.parameter >= samples.back().position)
+		{
+			first = second = static_cast<int>(samples.size()) - 1;
+			return;
+		}
+		while (source.parameter >= samples[second].position)
+			second++;
+		first = second - 1;
+		weight = (source.parameter - samples[first].position) / (samples[second].position - samples[first].position);
+	}
+
+	/**
+	 * @brief Advances the phase of a source at the rate of its blended cycle length, so blended
+	 * clips of different lengths stay in step, and moves every clip to that phase.
+	 */
+	static void AdvanceSource(PoseSource& source, float dt)
+	{
+		int first, second;
+		float weight;
+		FindBlendSamples(source, first, second, weight);
+
+		auto cycleSeconds = [](const SkeletalAnimation* clip) {
+			return clip->GetTicksPerSecond() > 0 ? clip->GetDuration() / clip->GetTicksPerSecond() : 0.0f;
+		};
+		float cycle = cycleSeconds(source.samples[first].clip) * (1.0f - weight)
+			+ cycleSeconds(source.samples[second].clip) * weight;
+		// clips of no duration (or no tick rate) hold their first pose
+		if (!(cycle > 0.0f))
+		{
+			source.phase = 0.0f;
+			for (auto& playback : source.playbacks)
+				playback.time = 0.0f;
+			return;
+		}
+
+		source.phase = fmod(source.phase + dt / cycle, 1.0f);
+		for (auto& playback : source.playbacks)
+			playback.time = source.phase * playback.clip->GetDuration();
+	}
+
+	/**
+	 * @brief Samples a clip into one pose per skeleton node; nodes it does not animate keep
+	 * their bind pose.
+	 */
+	void SampleNodePoses(const SkeletalAnimation& clip, float time, std::vector<BoneCursor>& cursors,
+		std::vector<LocalPose>& poses)
+	{
+		const auto& bindPose = clip.GetBindPose();
+		const auto& nodeTracks = clip.GetNodeTracks();
+		poses.resize(nodeTracks.size());
+		m_TrackPoses.resize(cursors.size());
+		clip.GetTracks().SampleLocalPoses(time, cursors.data(), m_TrackPoses.data());
+
+		for (size_t i = 0; i < nodeTracks.size(); i++)
+			poses[i] = nodeTracks[i] >= 0 ? m_TrackPoses[nodeTracks[i]] : bindPose[i];
+	}
+
+	void EvaluateSource(PoseSource& source, std::vector<LocalPose>& poses)
+	{
+		int first, second;
+		float weight;
+		FindBlendSamples(source, first, second, weight);
+
+		ClipPlayback& from = source.playbacks[first];
+		SampleNodePoses(*from.clip, from.time, from.cursors, poses);
+		if (second != first && weight > 0.0f)
+		{
+			ClipPlayback& to = source.playbacks[second];
+			SampleNodePoses(*to.clip, to.time, to.cursors, m_BlendPoses);
+			assert(m_BlendPoses.size() == poses.size());
+			BlendPoses(poses.data(), m_BlendPoses.data(), weight, poses.data(), static_cast<int>(poses.size()));
+		}
+	}
+
+	void ComposeNode(const std::vector<SkeletonNode>& skeleton, int i, const glm::mat4& nodeTransform)
+	{
+		const SkeletonNode& node = skeleton[i];
+		m_GlobalTransforms[i] = node.parent < 0 ? nodeTransform
+			: m_GlobalTransforms[node.parent] * nodeTransform;
+
+		if (node.paletteIndex >= 0)
+			m_FinalBoneMatrices[m_FrontPalette ^ 1][node.paletteIndex] = m_GlobalInverseTransform * m_GlobalTransforms[i] * node.offset;
+	}
+
+	inline bool IsFading() const { return !m_FadeSource.playbacks.empty(); }
+
+	/**
+	 * @brief Throws if a clip's poses cannot be blended with the other's node by node: both would
+	 * be indexed past the end of the smaller skeleton, or mix up bones of a reordered one.
+	 */
+	static void CheckSkeleton(const SkeletalAnimation& clip, const SkeletalAnimation& other)
+	{
+		if (!clip.HasSameSkeleton(other))
+			throw std::invalid_argument("clips '" + clip.GetName() + "' and '" + other.GetName()
+				+ "' pose different skeletons; load them against one shared skeleton to blend them");
+	}
+
+	/**
+	 * @brief Gives both palettes one slot per bone the model knew when the clip was loaded;
+	 * vertices never reference any other. New slots start as identity.
+	 */
+	void ResizePalettes(const SkeletalAnimation* clip)
+	{
+		int size = 0;
+		for (auto& bone : clip->GetBoneIDMap())
+			size = std::max(size, bone.second.id + 1);
+
+		for (auto& palette : m_FinalBoneMatrices)
+		{
+			if (static_cast<int>(palette.size()) < size)
+				palette.resize(size, glm::mat4(1.0f));
+		}
+	}
+
+	/**
+	 * @brief Sets every palette slot that no clip playing now writes to back to identity in both
+	 * palettes, so a slot only the previous clip drove does not keep its last matrix.
+	 */
+	void ResetUndrivenSlots()
+	{
+		std::vector<bool> driven(m_FinalBoneMatrices[0].size(), false);
+		auto markDriven = [&driven](const SkeletalAnimation* clip)
+		{
+			for (auto& node : clip->GetSkeleton())
+			{
+				if (node.paletteIndex >= 0 && node.paletteIndex < static_cast<int>(driven.size()))
+					driven[node.paletteIndex] = true;
+			}
+		};
+		for (auto& sample : m_Source.samples)
+			markDriven(sample.clip);
+		for (auto& sample : m_FadeSource.samples)
+			markDriven(sample.clip);
+		for (auto& layer : m_Layers)
+			markDriven(layer.playback.clip);
+
+		for (auto& palette : m_FinalBoneMatrices)
+		{
+			for (size_t i = 0; i < palette.size(); i++)
+			{
+				if (!driven[i])
+					palette[i] = glm::mat4(1.0f);
+			}
+		}
+	}
+
+	// front and back bone palettes, sized to the model's bone count
+	std::vector<glm::mat4> m_FinalBoneMatrices[2];
+	int m_FrontPalette;
+
+	PoseSource m_Source;
+	// what m_Source is fading in from; empty when no fade is in progress
+	PoseSource m_FadeSource;
+	float m_FadeTime;
+	float m_FadeDuration;
+	std::vector<AdditiveLayer> m_Layers;
+
+	// scratch buffers reused every update: local transforms per track for the single-clip path,
+	// poses per track and per node for blending, and global transforms per SkeletonNode
+	std::vector<glm::mat4> m_LocalTransforms;
+	std::vector<LocalPose> m_TrackPoses;
+	std::vector<LocalPose> m_NodePoses;
+	std::vector<LocalPose> m_FadePoses;
+	std::vector<LocalPose> m_BlendPoses;
+	std::vector<glm::mat4> m_GlobalTransforms;
 	float m_DeltaTime;
 
 	glm::mat4 m_GlobalInverseTransform;
-};
\ No newline at end of file
+};
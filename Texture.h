@@ -1,17 +1,27 @@
 #pragma once
+#include <memory>
 #include <string>
 #include <filesystem>
 #include <SFML/Graphics.hpp>
 
+struct TextureResidency;
+
 /**
  * @brief Represents a texture that has been loaded into VRAM, and is expected to be bound
  * to a sampler2D with a given sampler name in the fragment shader.
  */
 struct Texture {
 	// The ID of the texture, to be bound with glBindTexture when drawing a mesh.
-	uint32_t textureId;
+	uint32_t textureId = 0;
 	// The name of the sampler2D uniform in the fragment shader that this texture will bind to.
 	std::string samplerName;
+	// Keeps a TextureCache entry in use while any copy of the texture exists; empty for textures
+	// loaded with loadImage directly, which are never freed.
+	std::shared_ptr<TextureResidency> residency;
+	// The layer sampled if textureId is a GL_TEXTURE_2D_ARRAY, or -1 for a GL_TEXTURE_2D.
+	int layer = -1;
+
+	uint32_t target() const { return layer >= 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D; }
 
 	/**
 	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it.
@@ -29,6 +39,6 @@ struct Texture {
 		glGenerateMipmap(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
-		return Texture{ texId, samplerName };
+		return Texture{ texId, samplerName, nullptr, -1 };
 	}
 };
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "TextureCache.h"
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+TextureCache::~TextureCache() {
+	for (auto& [path, entry] : m_entries) {
+		glDeleteTextures(1, &entry.textureId);
+	}
+}
+
+TextureCache& TextureCache::shared() {
+	// Never destroyed: at exit the context, and every texture with it, may already be gone.
+	static TextureCache* cache = new TextureCache();
+	return *cache;
+}
+
+std::string TextureCache::canonicalPath(const std::string& path) {
+	std::error_code error;
+	auto canonical = std::filesystem::weakly_canonical(path, error);
+	return error ? path : canonical.string();
+}
+
+std::string TextureCache::cacheKey(const std::string& path, const std::string& samplerName) {
+	// the same split as the asset cache keys of loadTextureData
+	return samplerName == "normalMap" ? canonicalPath(path) + "#normalMap" : canonicalPath(path);
+}
+
+Texture TextureCache::use(const std::string& key, Entry& entry, const std::string& samplerName) {
+	auto residency = entry.residency.lock();
+	if (!residency) {
+		residency = std::make_shared<TextureResidency>(TextureResidency{ key });
+		entry.residency = residency;
+	}
+	entry.lastUse = ++m_useCount;
+	return Texture{ entry.textureId, samplerName, residency, entry.isArray ? 0 : -1 };
+}
+
+Texture TextureCache::insert(const std::string& key, const TextureData& data, const std::string& samplerName) {
+	Texture texture = uploadTextureData(data, samplerName);
+	size_t bytes = textureMemoryBytes(data);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Entry& entry = m_entries[key];
+	entry = Entry{ texture.textureId, data.isArray(), bytes, {}, 0 };
+	m_stats.residentBytes += bytes;
+	return use(key, entry, samplerName);
+}
+
+bool TextureCache::find(const std::string& key, const std::string& samplerName, Texture& texture) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto found = m_entries.find(key);
+	if (found == m_entries.end()) {
+		m_stats.misses++;
+		return false;
+	}
+	m_stats.hits++;
+	texture = use(key, found->second, samplerName);
+	return true;
+}
+
+Texture TextureCache::load(const std::string& path, const std::string& samplerName) {
+	std::string key = cacheKey(path, samplerName);
+	Texture texture;
+	if (find(key, samplerName, texture)) {
+		return texture;
+	}
+	collect();
+	return insert(key, loadTextureData(path, samplerName), samplerName);
+}
+
+Texture TextureCache::upload(const std::string& path, const TextureData& data, const std::string& samplerName) {
+	std::string key = cacheKey(path, samplerName);
+	Texture texture;
+	if (find(key, samplerName, texture)) {
+		return texture;
+	}
+	collect();
+
+	// The loading thread skipped a texture that has been evicted since.
+	if (data.empty()) {
+		return insert(key, loadTextureData(path, samplerName), samplerName);
+	}
+	return insert(key, data, samplerName);
+}
+
+Texture TextureCache::uploadArray(const std::string& path, const std::vector<std::string>& layerPaths, int layer,
+	const TextureData& data, const std::string& samplerName) {
+	std::string key = cacheKey(path, samplerName);
+	Texture texture;
+	if (!find(key, samplerName, texture)) {
+		collect();
+		texture = insert(key, data.empty() ? loadTextureArrayData(layerPaths, samplerName) : data, samplerName);
+	}
+	texture.layer = layer;
+	return texture;
+}
+
+bool TextureCache::isResident(const std::string& path, const std::string& samplerName) const {
+	std::string key = cacheKey(path, samplerName);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.count(key) > 0;
+}
+
+void TextureCache::collect() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_budget > 0 && m_stats.residentBytes <= m_budget) {
+		return;
+	}
+	std::vector<std::unordered_map<std::string, Entry>::iterator> unused;
+	for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+		if (it->second.residency.expired()) {
+			unused.push_back(it);
+		}
+	}
+	std::sort(unused.begin(), unused.end(), [](const auto& a, const auto& b) {
+		return a->second.lastUse < b->second.lastUse;
+	});
+	for (auto it : unused) {
+		if (m_budget > 0 && m_stats.residentBytes <= m_budget) {
+			break;
+		}
+		glDeleteTextures(1, &it->second.textureId);
+		m_stats.residentBytes -= it->second.bytes;
+		m_stats.evictions++;
+		m_entries.erase(it);
+	}
+}
+
+void TextureCache::setBudget(size_t bytes) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_budget = bytes;
+	}
+	collect();
+}
+
+TextureCacheStats TextureCache::getStats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	TextureCacheStats stats = m_stats;
+	stats.residentTextures = m_entries.size();
+	stats.unusedBytes = 0;
+	for (auto& [path, entry] : m_entries) {
+		if (entry.residency.expired()) {
+			stats.unusedBytes += entry.bytes;
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include <glad/glad.h>
+#include "Texture.h"
+#include "TextureData.h"
+
+/**
+ * @brief Marks a TextureCache entry as in use; shared by every Texture copy handed out for it.
+ */
+struct TextureResidency {
+	std::string path;
+};
+
+/**
+ * @brief What a TextureCache holds and how well it served requests.
+ */
+struct TextureCacheStats {
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+	size_t residentTextures = 0;
+	// bytes of texture memory held, mipmaps included, and how many of them no Texture uses
+	size_t residentBytes = 0;
+	size_t unusedBytes = 0;
+};
+
+/**
+ * @brief Shares texture uploads across models: every texture file is conditioned (see
+ * loadTextureData) and uploaded once, keyed by its canonical path and whether it is a normal
+ * map, however many meshes or models use it. Textures come out of the
+ * cache reference-counted; once no copy of one is left it is freed at the next collect, or kept
+ * for reuse while every texture fits the VRAM budget, least recently used freed first.
+ * Loads and frees happen on the thread owning the OpenGL context; isResident can be asked from
+ * any thread.
+ */
+class TextureCache {
+private:
+	struct Entry {
+		uint32_t textureId;
+		bool isArray;
+		size_t bytes;
+		std::weak_ptr<TextureResidency> residency;
+		uint64_t lastUse;
+	};
+
+	// by cacheKey
+	std::unordered_map<std::string, Entry> m_entries;
+	mutable std::mutex m_mutex;
+	size_t m_budget = 0;
+	uint64_t m_useCount = 0;
+	TextureCacheStats m_stats;
+
+	static std::string canonicalPath(const std::string& path);
+
+	/**
+	 * @brief The canonical path, marked for normal maps: a file used both as a normal map and as a
+	 * color map is conditioned into two formats (see chooseTextureFormat) and uploaded twice.
+	 */
+	static std::string cacheKey(const std::string& path, const std::string& samplerName);
+
+	/**
+	 * @brief Hands out a Texture for a resident entry, creating its residency if it was unused.
+	 */
+	Texture use(const std::string& key, Entry& entry, const std::string& samplerName);
+
+	/**
+	 * @brief Counts a hit or a miss for key, handing out its Texture on a hit.
+	 */
+	bool find(const std::string& key, const std::string& samplerName, Texture& texture);
+
+	Texture insert(const std::string& key, const TextureData& data, const std::string& samplerName);
+
+public:
+	TextureCache() = default;
+	~TextureCache();
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	/**
+	 * @brief Gets the cache shared by every model. Use it only after OpenGL is loaded.
+	 */
+	static TextureCache& shared();
+
+	/**
+	 * @brief Gets the texture of an image file, loading its conditioned mip chain and uploading it
+	 * on a miss.
+	 */
+	Texture load(const std::string& path, const std::string& samplerName);
+
+	/**
+	 * @brief Like load, for a texture conditioned elsewhere (on a loading thread, say); on a hit
+	 * the data is not needed, and empty data is loaded from the file on a miss.
+	 */
+	Texture upload(const std::string& path, const TextureData& data, const std::string& samplerName);
+
+	/**
+	 * @brief Like upload, for a texture array with a layer per file of layerPaths, which path only
+	 * names; the Texture samples the given layer.
+	 */
+	Texture uploadArray(const std::string& path, const std::vector<std::string>& layerPaths, int layer,
+		const TextureData& data, const std::string& samplerName);
+
+	/**
+	 * @brief Tells whether a file's texture is resident, so loading threads can skip conditioning it.
+	 * It may still be evicted before upload is called.
+	 */
+	bool isResident(const std::string& path, const std::string& samplerName) const;
+
+	/**
+	 * @brief Frees unused textures, least recently used first, until all resident textures fit the
+	 * budget (every unused texture without a budget).
+	 */
+	void collect();
+
+	/**
+	 * @brief Sets the bytes of texture memory all resident textures, in use or not, are kept within
+	 * by freeing unused ones; 0, the default, keeps no unused texture. Textures in use always stay,
+	 * even over the budget.
+	 */
+	void setBudget(size_t bytes);
+
+	TextureCacheStats getStats() const;
+};
@@ -0,0 +1,618 @@
+#include "TextureData.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <SFML/Window/Context.hpp>
+#include "AssetCache.h"
+#include "ThreadPool.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static size_t s_blockBytes(TextureFormat format) {
+	return format == TextureFormat::BC1 ? 8 : 16;
+}
+
+static uint32_t s_levelSize(uint32_t size, size_t level) {
+	return std::max(size >> level, 1u);
+}
+
+static size_t s_levelBytes(TextureFormat format, uint32_t width, uint32_t height) {
+	if (format == TextureFormat::RGBA8) {
+		return static_cast<size_t>(width) * height * 4;
+	}
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * s_blockBytes(format);
+}
+
+TextureFormat chooseTextureFormat(const sf::Image& image, const std::string& samplerName) {
+	if (samplerName == "normalMap") {
+		return TextureFormat::BC5;
+	}
+	const uint8_t* pixels = image.getPixelsPtr();
+	size_t count = static_cast<size_t>(image.getSize().x) * image.getSize().y;
+	for (size_t i = 0; i < count; i++) {
+		if (pixels[i * 4 + 3] < 255) {
+			return TextureFormat::BC3;
+		}
+	}
+	return TextureFormat::BC1;
+}
+
+// ----------------------------------------------------------------------------------------------
+// Block encoding
+
+static uint16_t s_pack565(const float color[3]) {
+	int r = static_cast<int>(std::round(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f));
+	int g = static_cast<int>(std::round(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f));
+	int b = static_cast<int>(std::round(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f));
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void s_unpack565(uint16_t packed, int color[3]) {
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+/**
+ * @brief The four colors of a BC1 block in four-color mode (color0 > color1), as BC3 always uses.
+ */
+static void s_colorPalette(uint16_t color0, uint16_t color1, int palette[4][3]) {
+	s_unpack565(color0, palette[0]);
+	s_unpack565(color1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+}
+
+/**
+ * @brief Encodes the colors of 16 RGBA texels as a four-color BC1 block, with endpoints at the
+ * extremes of the texels along their principal axis.
+ */
+static void s_encodeColorBlock(const uint8_t texels[64], uint8_t out[8]) {
+	float mean[3] = {};
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			mean[c] += texels[i * 4 + c] / 16.0f;
+		}
+	}
+	float covariance[3][3] = {};
+	for (int i = 0; i < 16; i++) {
+		float d[3] = { texels[i * 4] - mean[0], texels[i * 4 + 1] - mean[1], texels[i * 4 + 2] - mean[2] };
+		for (int a = 0; a < 3; a++) {
+			for (int b = 0; b < 3; b++) {
+				covariance[a][b] += d[a] * d[b];
+			}
+		}
+	}
+	// A few power iterations find the axis along which the colors spread the most.
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 4; iteration++) {
+		float next[3];
+		for (int a = 0; a < 3; a++) {
+			next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+		}
+		float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1e-6f) {
+			break;
+		}
+		for (int a = 0; a < 3; a++) {
+			axis[a] = next[a] / length;
+		}
+	}
+	float lowest = 0.0f;
+	float highest = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (int c = 0; c < 3; c++) {
+			t += (texels[i * 4 + c] - mean[c]) * axis[c];
+		}
+		lowest = std::min(lowest, t);
+		highest = std::max(highest, t);
+	}
+	float high[3];
+	float low[3];
+	for (int c = 0; c < 3; c++) {
+		high[c] = mean[c] + axis[c] * highest;
+		low[c] = mean[c] + axis[c] * lowest;
+	}
+	uint16_t color0 = s_pack565(high);
+	uint16_t color1 = s_pack565(low);
+	if (color0 < color1) {
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		int palette[4][3];
+		s_colorPalette(color0, color1, palette);
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			int bestDistance = INT32_MAX;
+			for (int entry = 0; entry < 4; entry++) {
+				int distance = 0;
+				for (int c = 0; c < 3; c++) {
+					int d = texels[i * 4 + c] - palette[entry][c];
+					distance += d * d;
+				}
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = entry;
+				}
+			}
+			indices |= static_cast<uint32_t>(best) << (i * 2);
+		}
+	}
+	std::memcpy(out, &color0, 2);
+	std::memcpy(out + 2, &color1, 2);
+	std::memcpy(out + 4, &indices, 4);
+}
+
+/**
+ * @brief The eight values of a BC4 block in eight-value mode (value0 > value1).
+ */
+static void s_channelPalette(uint8_t value0, uint8_t value1, int palette[8]) {
+	palette[0] = value0;
+	palette[1] = value1;
+	for (int i = 1; i < 7; i++) {
+		palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+	}
+}
+
+/**
+ * @brief Encodes one channel of 16 RGBA texels as a BC4 block, the alpha half of BC3 and either
+ * half of BC5.
+ */
+static void s_encodeChannelBlock(const uint8_t texels[64], int channel, uint8_t out[8]) {
+	uint8_t highest = 0;
+	uint8_t lowest = 255;
+	for (int i = 0; i < 16; i++) {
+		highest = std::max(highest, texels[i * 4 + channel]);
+		lowest = std::min(lowest, texels[i * 4 + channel]);
+	}
+
+	uint64_t indices = 0;
+	if (highest != lowest) {
+		int palette[8];
+		s_channelPalette(highest, lowest, palette);
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			for (int entry = 1; entry < 8; entry++) {
+				if (std::abs(texels[i * 4 + channel] - palette[entry]) < std::abs(texels[i * 4 + channel] - palette[best])) {
+					best = entry;
+				}
+			}
+			indices |= static_cast<uint64_t>(best) << (i * 3);
+		}
+	}
+	out[0] = highest;
+	out[1] = lowest;
+	for (int byte = 0; byte < 6; byte++) {
+		out[2 + byte] = static_cast<uint8_t>(indices >> (byte * 8));
+	}
+}
+
+static void s_encodeBlock(const uint8_t texels[64], TextureFormat format, uint8_t* out) {
+	switch (format) {
+	case TextureFormat::BC1:
+		s_encodeColorBlock(texels, out);
+		break;
+	case TextureFormat::BC3:
+		s_encodeChannelBlock(texels, 3, out);
+		s_encodeColorBlock(texels, out + 8);
+		break;
+	case TextureFormat::BC5:
+		s_encodeChannelBlock(texels, 0, out);
+		s_encodeChannelBlock(texels, 1, out + 8);
+		break;
+	default:
+		break;
+	}
+}
+
+// ----------------------------------------------------------------------------------------------
+// Block decoding, for drivers without S3TC
+
+static void s_decodeColorBlock(const uint8_t* block, bool fourColors, uint8_t texels[64]) {
+	uint16_t color0;
+	uint16_t color1;
+	uint32_t indices;
+	std::memcpy(&color0, block, 2);
+	std::memcpy(&color1, block + 2, 2);
+	std::memcpy(&indices, block + 4, 4);
+	int palette[4][3];
+	s_colorPalette(color0, color1, palette);
+	bool transparent = !fourColors && color0 <= color1;
+	if (transparent) {
+		// three colors and transparent black
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	for (int i = 0; i < 16; i++) {
+		int index = (indices >> (i * 2)) & 3;
+		for (int c = 0; c < 3; c++) {
+			texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+		}
+		texels[i * 4 + 3] = transparent && index == 3 ? 0 : 255;
+	}
+}
+
+static void s_decodeChannelBlock(const uint8_t* block, int channel, uint8_t texels[64]) {
+	int palette[8];
+	if (block[0] > block[1]) {
+		s_channelPalette(block[0], block[1], palette);
+	}
+	else {
+		// six values, then 0 and 255
+		palette[0] = block[0];
+		palette[1] = block[1];
+		for (int i = 1; i < 5; i++) {
+			palette[i + 1] = ((5 - i) * block[0] + i * block[1]) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	uint64_t indices = 0;
+	for (int byte = 0; byte < 6; byte++) {
+		indices |= static_cast<uint64_t>(block[2 + byte]) << (byte * 8);
+	}
+	for (int i = 0; i < 16; i++) {
+		texels[i * 4 + channel] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 7]);
+	}
+}
+
+/**
+ * @brief Decodes a BC1 or BC3 level to RGBA8.
+ */
+static std::vector<uint8_t> s_decodeLevel(const uint8_t* blocks, TextureFormat format, uint32_t width, uint32_t height) {
+	std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+	uint8_t texels[64];
+	for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+		for (uint32_t bx = 0; bx < (width + 3) / 4; bx++) {
+			if (format == TextureFormat::BC3) {
+				s_decodeColorBlock(blocks + 8, true, texels);
+				s_decodeChannelBlock(blocks, 3, texels);
+			}
+			else {
+				s_decodeColorBlock(blocks, false, texels);
+			}
+			blocks += s_blockBytes(format);
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+					std::memcpy(&pixels[((by * 4 + y) * static_cast<size_t>(width) + bx * 4 + x) * 4], &texels[(y * 4 + x) * 4], 4);
+				}
+			}
+		}
+	}
+	return pixels;
+}
+
+// ----------------------------------------------------------------------------------------------
+
+/**
+ * @brief Halves a level with a box filter; odd rows and columns are folded into the last texel,
+ * which then averages three texels across instead of two.
+ */
+static std::vector<uint8_t> s_downsample(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height) {
+	uint32_t halfWidth = std::max(width / 2, 1u);
+	uint32_t halfHeight = std::max(height / 2, 1u);
+	std::vector<uint8_t> half(static_cast<size_t>(halfWidth) * halfHeight * 4);
+	for (uint32_t y = 0; y < halfHeight; y++) {
+		uint32_t y0 = y * 2;
+		uint32_t y1 = y + 1 == halfHeight ? height : y0 + 2;
+		for (uint32_t x = 0; x < halfWidth; x++) {
+			uint32_t x0 = x * 2;
+			uint32_t x1 = x + 1 == halfWidth ? width : x0 + 2;
+			uint32_t count = (x1 - x0) * (y1 - y0);
+			for (int c = 0; c < 4; c++) {
+				uint32_t sum = 0;
+				for (uint32_t sy = y0; sy < y1; sy++) {
+					for (uint32_t sx = x0; sx < x1; sx++) {
+						sum += pixels[(sy * static_cast<size_t>(width) + sx) * 4 + c];
+					}
+				}
+				half[(y * static_cast<size_t>(halfWidth) + x) * 4 + c] = static_cast<uint8_t>((sum + count / 2) / count);
+			}
+		}
+	}
+	return half;
+}
+
+/**
+ * @brief Resizes an image bilinearly, for texture array layers smaller than the others.
+ */
+static std::vector<uint8_t> s_resize(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t newWidth,
+	uint32_t newHeight) {
+	std::vector<uint8_t> resized(static_cast<size_t>(newWidth) * newHeight * 4);
+	for (uint32_t y = 0; y < newHeight; y++) {
+		float sy = std::clamp((y + 0.5f) * height / newHeight - 0.5f, 0.0f, height - 1.0f);
+		uint32_t y0 = static_cast<uint32_t>(sy);
+		uint32_t y1 = std::min(y0 + 1, height - 1);
+		float fy = sy - y0;
+		for (uint32_t x = 0; x < newWidth; x++) {
+			float sx = std::clamp((x + 0.5f) * width / newWidth - 0.5f, 0.0f, width - 1.0f);
+			uint32_t x0 = static_cast<uint32_t>(sx);
+			uint32_t x1 = std::min(x0 + 1, width - 1);
+			float fx = sx - x0;
+			for (int c = 0; c < 4; c++) {
+				float top = pixels[(y0 * static_cast<size_t>(width) + x0) * 4 + c] * (1.0f - fx)
+					+ pixels[(y0 * static_cast<size_t>(width) + x1) * 4 + c] * fx;
+				float bottom = pixels[(y1 * static_cast<size_t>(width) + x0) * 4 + c] * (1.0f - fx)
+					+ pixels[(y1 * static_cast<size_t>(width) + x1) * 4 + c] * fx;
+				resized[(y * static_cast<size_t>(newWidth) + x) * 4 + c] =
+					static_cast<uint8_t>(std::round(top * (1.0f - fy) + bottom * fy));
+			}
+		}
+	}
+	return resized;
+}
+
+/**
+ * @brief Encodes one level of one layer at the end of data.
+ */
+static void s_appendLevel(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, TextureFormat format,
+	std::vector<uint8_t>& data) {
+	size_t start = data.size();
+	data.resize(start + s_levelBytes(format, width, height));
+	uint8_t* out = data.data() + start;
+
+	if (format == TextureFormat::RGBA8) {
+		std::memcpy(out, pixels.data(), pixels.size());
+		return;
+	}
+	// Blocks past the edge of a level smaller than 4 texels, or not a multiple of 4, repeat the edge.
+	uint8_t texels[64];
+	for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+		for (uint32_t bx = 0; bx < (width + 3) / 4; bx++) {
+			for (uint32_t y = 0; y < 4; y++) {
+				for (uint32_t x = 0; x < 4; x++) {
+					uint32_t sx = std::min(bx * 4 + x, width - 1);
+					uint32_t sy = std::min(by * 4 + y, height - 1);
+					std::memcpy(&texels[(y * 4 + x) * 4], &pixels[(sy * static_cast<size_t>(width) + sx) * 4], 4);
+				}
+			}
+			s_encodeBlock(texels, format, out);
+			out += s_blockBytes(format);
+		}
+	}
+}
+
+/**
+ * @brief Builds the mip chains of equally sized layers, storing each level's layers together.
+ */
+static TextureData s_condition(std::vector<std::vector<uint8_t>>&& layers, uint32_t width, uint32_t height,
+	TextureFormat format) {
+	TextureData texture;
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	texture.layers = static_cast<uint32_t>(layers.size());
+	texture.levelOffsets.push_back(0);
+	while (true) {
+		for (auto& layer : layers) {
+			s_appendLevel(layer, width, height, format, texture.data);
+		}
+		texture.levelOffsets.push_back(texture.data.size());
+		if (width == 1 && height == 1) {
+			break;
+		}
+		for (auto& layer : layers) {
+			layer = s_downsample(layer, width, height);
+		}
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+	return texture;
+}
+
+TextureData conditionImage(const sf::Image& image, TextureFormat format) {
+	if (image.getSize().x == 0 || image.getSize().y == 0) {
+		TextureData texture;
+		texture.format = format;
+		return texture;
+	}
+	const uint8_t* source = image.getPixelsPtr();
+	std::vector<std::vector<uint8_t>> layers;
+	layers.emplace_back(source, source + static_cast<size_t>(image.getSize().x) * image.getSize().y * 4);
+	return s_condition(std::move(layers), image.getSize().x, image.getSize().y, format);
+}
+
+TextureData conditionImageArray(const std::vector<sf::Image>& images, TextureFormat format) {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	for (auto& image : images) {
+		width = std::max(width, image.getSize().x);
+		height = std::max(height, image.getSize().y);
+	}
+	if (width == 0 || height == 0) {
+		TextureData texture;
+		texture.format = format;
+		return texture;
+	}
+
+	std::vector<std::vector<uint8_t>> layers;
+	for (auto& image : images) {
+		const uint8_t* source = image.getPixelsPtr();
+		if (image.getSize().x == width && image.getSize().y == height) {
+			layers.emplace_back(source, source + static_cast<size_t>(width) * height * 4);
+		}
+		else if (image.getSize().x == 0 || image.getSize().y == 0) {
+			// an image that failed to load leaves its layer black
+			layers.emplace_back(static_cast<size_t>(width) * height * 4, 0);
+		}
+		else {
+			layers.push_back(s_resize(source, image.getSize().x, image.getSize().y, width, height));
+		}
+	}
+	return s_condition(std::move(layers), width, height, format);
+}
+
+static bool s_readTextureData(const std::filesystem::path& path, uint64_t key, TextureData& texture) {
+	MappedFile file(path);
+	BinaryReader reader(nullptr, 0);
+	if (!openAssetCache(file, "texture", key, reader)) {
+		return false;
+	}
+	texture.format = reader.read<TextureFormat>();
+	texture.width = reader.read<uint32_t>();
+	texture.height = reader.read<uint32_t>();
+	texture.layers = reader.read<uint32_t>();
+	reader.readVector(texture.levelOffsets);
+	reader.readVector(texture.data);
+	return !reader.failed() && !texture.levelOffsets.empty() && texture.levelOffsets.back() == texture.data.size();
+}
+
+static void s_writeTextureData(const std::filesystem::path& path, uint64_t key, const TextureData& texture) {
+	BinaryWriter writer;
+	beginAssetCache(writer, "texture", key);
+	writer.write(texture.format);
+	writer.write(texture.width);
+	writer.write(texture.height);
+	writer.write(texture.layers);
+	writer.writeVector(texture.levelOffsets);
+	writer.writeVector(texture.data);
+	writer.saveTo(path);
+}
+
+TextureData loadTextureData(const std::string& path, const std::string& samplerName) {
+	// Normal maps get another format, so the sampler is part of the key.
+	uint64_t key = hashCombine(hashFile(path), samplerName == "normalMap" ? 1 : 0);
+	TextureData texture;
+	if (s_readTextureData(assetCachePath(path, "texture", key), key, texture)) {
+		return texture;
+	}
+
+	sf::Image image;
+	image.loadFromFile(path);
+	texture = conditionImage(image, chooseTextureFormat(image, samplerName));
+	if (!texture.empty()) {
+		s_writeTextureData(assetCachePath(path, "texture", key), key, texture);
+	}
+	return texture;
+}
+
+TextureData loadTextureArrayData(const std::vector<std::string>& paths, const std::string& samplerName) {
+	uint64_t key = hashCombine(paths.size(), samplerName == "normalMap" ? 1 : 0);
+	for (auto& path : paths) {
+		key = hashCombine(key, hashFile(path));
+	}
+	TextureData texture;
+	if (paths.empty() || s_readTextureData(assetCachePath(paths[0], "texture", key), key, texture)) {
+		return texture;
+	}
+
+	// Runs inline when the whole array is itself one job of a parallelFor, as in importModel.
+	std::vector<sf::Image> images(paths.size());
+	ThreadPool::shared().parallelFor(static_cast<int>(paths.size()), 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			images[i].loadFromFile(paths[i]);
+		}
+	});
+
+	// Every layer shares a format: with transparency if any layer has some.
+	TextureFormat format = TextureFormat::BC1;
+	for (auto& image : images) {
+		if (image.getSize().x > 0 && image.getSize().y > 0) {
+			TextureFormat layerFormat = chooseTextureFormat(image, samplerName);
+			if (layerFormat != TextureFormat::BC1) {
+				format = layerFormat;
+			}
+		}
+	}
+	texture = conditionImageArray(images, format);
+	if (!texture.empty()) {
+		s_writeTextureData(assetCachePath(paths[0], "texture", key), key, texture);
+	}
+	return texture;
+}
+
+static bool s_supportsS3tc() {
+	static bool supported = [] {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+				return true;
+			}
+		}
+		return false;
+	}();
+	return supported;
+}
+
+static bool s_uploadsCompressed(TextureFormat format) {
+	return format == TextureFormat::BC5 || (format != TextureFormat::RGBA8 && s_supportsS3tc());
+}
+
+Texture uploadTextureData(const TextureData& texture, const std::string& samplerName) {
+	GLenum target = texture.isArray() ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+	uint32_t texId;
+	glGenTextures(1, &texId);
+	glBindTexture(target, texId);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(std::max<size_t>(texture.levelCount(), 1) - 1));
+
+	bool compressed = s_uploadsCompressed(texture.format);
+	GLenum internalFormat = texture.format == TextureFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+		: texture.format == TextureFormat::BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+		: GL_COMPRESSED_RG_RGTC2;
+	for (size_t level = 0; level < texture.levelCount(); level++) {
+		GLint mip = static_cast<GLint>(level);
+		uint32_t width = s_levelSize(texture.width, level);
+		uint32_t height = s_levelSize(texture.height, level);
+		const uint8_t* data = texture.data.data() + texture.levelOffsets[level];
+		GLsizei size = static_cast<GLsizei>(texture.levelOffsets[level + 1] - texture.levelOffsets[level]);
+
+		std::vector<uint8_t> pixels;
+		if (!compressed && texture.format != TextureFormat::RGBA8) {
+			size_t layerBytes = s_levelBytes(texture.format, width, height);
+			for (uint32_t layer = 0; layer < texture.layers; layer++) {
+				std::vector<uint8_t> decoded = s_decodeLevel(data + layer * layerBytes, texture.format, width, height);
+				pixels.insert(pixels.end(), decoded.begin(), decoded.end());
+			}
+			data = pixels.data();
+		}
+
+		if (compressed && texture.isArray()) {
+			glCompressedTexImage3D(target, mip, internalFormat, width, height, texture.layers, 0, size, data);
+		}
+		else if (compressed) {
+			glCompressedTexImage2D(target, mip, internalFormat, width, height, 0, size, data);
+		}
+		else if (texture.isArray()) {
+			glTexImage3D(target, mip, GL_RGBA, width, height, texture.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
+		else {
+			glTexImage2D(target, mip, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
+	}
+	glBindTexture(target, 0);
+
+	return Texture{ texId, samplerName, nullptr, texture.isArray() ? 0 : -1 };
+}
+
+size_t textureMemoryBytes(const TextureData& texture) {
+	if (s_uploadsCompressed(texture.format)) {
+		return texture.data.size();
+	}
+	size_t bytes = 0;
+	for (size_t level = 0; level < texture.levelCount(); level++) {
+		bytes += s_levelBytes(TextureFormat::RGBA8, s_levelSize(texture.width, level), s_levelSize(texture.height, level))
+			* texture.layers;
+	}
+	return bytes;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <SFML/Graphics.hpp>
+#include <glad/glad.h>
+#include "Texture.h"
+
+/**
+ * @brief How the levels of a TextureData are encoded.
+ */
+enum class TextureFormat : uint32_t {
+	// uncompressed, 4 bytes per texel
+	RGBA8,
+	// 8 bytes per 4x4 block: RGB, for opaque color maps
+	BC1,
+	// 16 bytes per 4x4 block: RGB plus alpha, for color maps with transparency
+	BC3,
+	// 16 bytes per 4x4 block: two channels, for normal maps (z is rebuilt in the shader)
+	BC5,
+};
+
+/**
+ * @brief A texture's full mip chain, from full size down to 1x1, ready to upload without
+ * decoding or generating anything at load time. A texture with several layers is a texture
+ * array, its layers stored one after another within each level.
+ */
+struct TextureData {
+	TextureFormat format = TextureFormat::RGBA8;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t layers = 1;
+	// where each level starts in data; the last entry is the end of the data
+	std::vector<uint64_t> levelOffsets;
+	std::vector<uint8_t> data;
+
+	bool empty() const { return levelOffsets.empty(); }
+	bool isArray() const { return layers > 1; }
+	size_t levelCount() const { return levelOffsets.empty() ? 0 : levelOffsets.size() - 1; }
+};
+
+/**
+ * @brief Picks BC5 for normal maps, BC3 for images with transparent texels and BC1 otherwise.
+ */
+TextureFormat chooseTextureFormat(const sf::Image& image, const std::string& samplerName);
+
+/**
+ * @brief Builds an image's mip chain with a box filter and encodes every level in format.
+ */
+TextureData conditionImage(const sf::Image& image, TextureFormat format);
+
+/**
+ * @brief Like conditionImage, for the layers of a texture array; images smaller than the largest
+ * are scaled up to its size.
+ */
+TextureData conditionImageArray(const std::vector<sf::Image>& images, TextureFormat format);
+
+/**
+ * @brief Gets the conditioned texture of an image file from the asset cache, or decodes and
+ * conditions the image and stores the result there. Needs no OpenGL context.
+ */
+TextureData loadTextureData(const std::string& path, const std::string& samplerName);
+
+/**
+ * @brief Like loadTextureData, for a texture array with a layer per image file. The files are
+ * decoded in parallel and the layers share one format, BC3 if any of them has transparency.
+ */
+TextureData loadTextureArrayData(const std::vector<std::string>& paths, const std::string& samplerName);
+
+/**
+ * @brief Uploads every level of a conditioned texture, as a GL_TEXTURE_2D_ARRAY if it has several
+ * layers (the Texture then samples layer 0). BC1 and BC3 are decoded to RGBA8 first if the
+ * driver lacks S3TC; BC5 (RGTC) is core since OpenGL 3.0.
+ */
+Texture uploadTextureData(const TextureData& texture, const std::string& samplerName);
+
+/**
+ * @brief Bytes of texture memory uploadTextureData takes for a texture.
+ */
+size_t textureMemoryBytes(const TextureData& texture);
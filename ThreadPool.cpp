@@ -0,0 +1,157 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Whether the thread is running ranges of a parallelFor, as a worker or as its caller.
+static thread_local bool s_inLoop = false;
+
+/**
+ * @brief Marks the calling thread as inside a loop for as long as it exists.
+ */
+struct LoopScope {
+	bool outer;
+	LoopScope() : outer(s_inLoop) { s_inLoop = true; }
+	~LoopScope() { s_inLoop = outer; }
+};
+
+ThreadPool::ThreadPool(int threadCount)
+	: m_generation(0), m_stopping(false), m_pending(0), m_failed(false) {
+	if (threadCount <= 0) {
+		threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+	for (int i = 0; i < threadCount; i++) {
+		m_queues.push_back(std::make_unique<Queue>());
+	}
+	for (int i = 1; i < threadCount; i++) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool& ThreadPool::shared() {
+	// Never destroyed: loading threads may still be using it at exit.
+	static ThreadPool* pool = new ThreadPool();
+	return *pool;
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::parallelFor(int count, int grain, const std::function<void(int, int)>& body) {
+	if (count <= 0) {
+		return;
+	}
+	grain = std::max(1, grain);
+	int ranges = (count + grain - 1) / grain;
+	if (ranges == 1 || m_workers.empty() || s_inLoop) {
+		LoopScope scope;
+		body(0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> loop(m_loopMutex);
+	LoopScope scope;
+
+	// Deal the ranges out round-robin; stealing evens out whatever this gets wrong.
+	m_pending.store(ranges);
+	for (int i = 0; i < ranges; i++) {
+		Queue& queue = *m_queues[i % m_queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.ranges.push_back(Range{ i * grain, std::min(count, (i + 1) * grain), &body });
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	// Once every queue is empty, only ranges other threads are running are left to wait for.
+	while (runOne(0)) {
+	}
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_pending.load() == 0; });
+	}
+
+	if (m_failed.load()) {
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			std::swap(error, m_error);
+		}
+		m_failed.store(false);
+		std::rethrow_exception(error);
+	}
+}
+
+void ThreadPool::workerLoop(int self) {
+	LoopScope scope;
+	uint64_t seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_stopping || m_generation != seen; });
+			if (m_stopping) {
+				return;
+			}
+			seen = m_generation;
+		}
+		// Ranges are only queued before a loop's generation is announced, so a thread that finds
+		// every queue empty has nothing left to do until the next loop.
+		while (runOne(self)) {
+		}
+	}
+}
+
+bool ThreadPool::runOne(int self) {
+	Range range;
+	bool found = false;
+	{
+		// The owner works from the back of its queue, thieves take from the front.
+		Queue& own = *m_queues[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.ranges.empty()) {
+			range = own.ranges.back();
+			own.ranges.pop_back();
+			found = true;
+		}
+	}
+	for (size_t i = 1; !found && i < m_queues.size(); i++) {
+		Queue& victim = *m_queues[(self + i) % m_queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.ranges.empty()) {
+			range = victim.ranges.front();
+			victim.ranges.pop_front();
+			found = true;
+		}
+	}
+	if (!found) {
+		return false;
+	}
+
+	// A range that throws still counts as done, or parallelFor would wait for it forever.
+	if (!m_failed.load()) {
+		try {
+			(*range.body)(range.begin, range.end);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_error) {
+				m_error = std::current_exception();
+			}
+			m_failed.store(true);
+		}
+	}
+	if (m_pending.fetch_sub(1) == 1) {
+		// under the mutex, so the caller cannot miss it between checking m_pending and waiting
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_done.notify_one();
+	}
+	return true;
+}
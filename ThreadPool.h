@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of worker threads that run parallel loops. Each thread owns a queue of
+ * index ranges, takes work from its own queue first and steals from the others once it runs dry,
+ * so uneven ranges (characters with more bones, say) balance out. Threads with nothing to run
+ * sleep on condition variables rather than spinning, so an idle pool costs no CPU time.
+ */
+class ThreadPool {
+private:
+	struct Range {
+		int begin;
+		int end;
+		const std::function<void(int, int)>* body;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Range> ranges;
+	};
+
+	// One queue per thread; queue 0 belongs to the thread calling parallelFor.
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	// held for a whole parallelFor, so loops started from several threads run one after another
+	std::mutex m_loopMutex;
+	// workers wait on m_wake for a new loop, the caller of parallelFor on m_done for its last ranges
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_generation;
+	bool m_stopping;
+	std::atomic<int> m_pending;
+	// the first exception a range of the current loop threw; once set, the rest of the ranges are skipped
+	std::exception_ptr m_error;
+	std::atomic<bool> m_failed;
+
+	void workerLoop(int self);
+
+	/**
+	 * @brief Runs one range from the thread's own queue, or steals one from another queue.
+	 * @return false if every queue was empty.
+	 */
+	bool runOne(int self);
+
+public:
+	/**
+	 * @brief Creates a pool of threadCount threads in total: the caller of parallelFor is one of
+	 * them, so threadCount - 1 workers are started. 0 uses every hardware thread.
+	 */
+	explicit ThreadPool(int threadCount = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * @brief Gets a pool of every hardware thread for loading work, such as decoding textures,
+	 * started on first use.
+	 */
+	static ThreadPool& shared();
+
+	int getThreadCount() const { return static_cast<int>(m_queues.size()); }
+
+	/**
+	 * @brief Calls body(begin, end) over [0, count) in ranges of at most grain indices and returns
+	 * once all of them have run. The calling thread works too. Loops started from several threads
+	 * at once run one after another, and a loop started from within a body runs inline on that
+	 * body's thread. If body throws, ranges not yet started are skipped and the
+	 * first exception is rethrown on the calling thread once every running range has finished.
+	 */
+	void parallelFor(int count, int grain, const std::function<void(int, int)>& body);
+};
@@ -0,0 +1,178 @@
+#include "TransformHierarchy.h"
+#include <algorithm>
+#include <glm/ext.hpp>
+
+TransformHierarchy& TransformHierarchy::shared() {
+	// Never destroyed: objects destroyed at exit still free their transforms.
+	static TransformHierarchy* hierarchy = new TransformHierarchy();
+	return *hierarchy;
+}
+
+uint32_t TransformHierarchy::create(const glm::mat4& baseTransform) {
+	uint32_t transform;
+	if (!m_freeSlots.empty()) {
+		transform = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else {
+		transform = static_cast<uint32_t>(m_parents.size());
+		m_parents.emplace_back();
+		m_positions.emplace_back();
+		m_orientations.emplace_back();
+		m_scales.emplace_back();
+		m_centers.emplace_back();
+		m_baseTransforms.emplace_back();
+		m_localMatrices.emplace_back();
+		m_worldMatrices.emplace_back();
+		m_flags.emplace_back();
+		m_worldChanged.emplace_back();
+	}
+	m_parents[transform] = NO_TRANSFORM;
+	m_flags[transform] = IN_USE;
+	resetLocal(transform);
+	m_baseTransforms[transform] = baseTransform;
+	m_orderDirty = true;
+	return transform;
+}
+
+void TransformHierarchy::destroy(uint32_t transform) {
+	m_flags[transform] = 0;
+	m_parents[transform] = NO_TRANSFORM;
+	m_freeSlots.push_back(transform);
+	m_orderDirty = true;
+	m_dirty = true;
+}
+
+void TransformHierarchy::setParent(uint32_t transform, uint32_t parent) {
+	if (m_parents[transform] == parent) {
+		return;
+	}
+	m_parents[transform] = parent;
+	markDirty(transform);
+	m_orderDirty = true;
+}
+
+void TransformHierarchy::copyLocal(uint32_t source, uint32_t transform) {
+	m_positions[transform] = m_positions[source];
+	m_orientations[transform] = m_orientations[source];
+	m_scales[transform] = m_scales[source];
+	m_centers[transform] = m_centers[source];
+	m_baseTransforms[transform] = m_baseTransforms[source];
+	markDirty(transform);
+}
+
+void TransformHierarchy::resetLocal(uint32_t transform) {
+	m_positions[transform] = glm::vec3(0);
+	m_orientations[transform] = glm::vec3(0);
+	m_scales[transform] = glm::vec3(1);
+	m_centers[transform] = glm::vec3(0);
+	m_baseTransforms[transform] = glm::mat4(1);
+	markDirty(transform);
+}
+
+void TransformHierarchy::markDirty(uint32_t transform) {
+	m_flags[transform] |= LOCAL_DIRTY;
+	m_dirty = true;
+}
+
+void TransformHierarchy::setPosition(uint32_t transform, const glm::vec3& position) {
+	m_positions[transform] = position;
+	markDirty(transform);
+}
+
+void TransformHierarchy::setOrientation(uint32_t transform, const glm::vec3& orientation) {
+	m_orientations[transform] = orientation;
+	markDirty(transform);
+}
+
+void TransformHierarchy::setScale(uint32_t transform, const glm::vec3& scale) {
+	m_scales[transform] = scale;
+	markDirty(transform);
+}
+
+void TransformHierarchy::setCenter(uint32_t transform, const glm::vec3& center) {
+	m_centers[transform] = center;
+	markDirty(transform);
+}
+
+/**
+ * @brief Sorts the transforms in use by depth, so each comes after its parent. Depths are found
+ * by walking up to the nearest transform whose depth is known.
+ */
+void TransformHierarchy::rebuildOrder() {
+	size_t count = m_parents.size();
+	std::vector<int32_t> depths(count, -1);
+	std::vector<uint32_t> path;
+	int32_t maxDepth = -1;
+	for (uint32_t i = 0; i < count; i++) {
+		if (!(m_flags[i] & IN_USE) || depths[i] >= 0) {
+			continue;
+		}
+		uint32_t transform = i;
+		while (transform != NO_TRANSFORM && depths[transform] < 0) {
+			path.push_back(transform);
+			transform = m_parents[transform];
+		}
+		int32_t depth = transform == NO_TRANSFORM ? -1 : depths[transform];
+		while (!path.empty()) {
+			depths[path.back()] = ++depth;
+			path.pop_back();
+		}
+		maxDepth = std::max(maxDepth, depth);
+	}
+
+	// counting sort, keeping slot order within a depth
+	std::vector<uint32_t> starts(maxDepth + 2, 0);
+	for (uint32_t i = 0; i < count; i++) {
+		if (depths[i] >= 0) {
+			starts[depths[i] + 1]++;
+		}
+	}
+	for (size_t depth = 1; depth < starts.size(); depth++) {
+		starts[depth] += starts[depth - 1];
+	}
+	m_order.resize(starts.back());
+	for (uint32_t i = 0; i < count; i++) {
+		if (depths[i] >= 0) {
+			m_order[starts[depths[i]]++] = i;
+		}
+	}
+	m_orderDirty = false;
+}
+
+void TransformHierarchy::update() {
+	if (!m_dirty) {
+		return;
+	}
+	if (m_orderDirty) {
+		rebuildOrder();
+	}
+
+	size_t recomputed = 0;
+	for (uint32_t transform : m_order) {
+		bool changed = m_flags[transform] & LOCAL_DIRTY;
+		if (changed) {
+			auto m = glm::translate(glm::mat4(1), m_positions[transform]);
+			m = glm::translate(m, m_centers[transform] * m_scales[transform]);
+			m = glm::rotate(m, m_orientations[transform][2], glm::vec3(0, 0, 1));
+			m = glm::rotate(m, m_orientations[transform][0], glm::vec3(1, 0, 0));
+			m = glm::rotate(m, m_orientations[transform][1], glm::vec3(0, 1, 0));
+			m = glm::scale(m, m_scales[transform]);
+			m = glm::translate(m, -m_centers[transform]);
+			m_localMatrices[transform] = m * m_baseTransforms[transform];
+			m_flags[transform] &= ~LOCAL_DIRTY;
+		}
+
+		uint32_t parent = m_parents[transform];
+		changed = changed || (parent != NO_TRANSFORM && m_worldChanged[parent]);
+		m_worldChanged[transform] = changed;
+		if (changed) {
+			m_worldMatrices[transform] = parent == NO_TRANSFORM
+				? m_localMatrices[transform]
+				: m_worldMatrices[parent] * m_localMatrices[transform];
+			recomputed++;
+		}
+	}
+	m_lastRecomputed = recomputed;
+	m_dirty = false;
+}
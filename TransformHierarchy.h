@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/**
+ * @brief The local and world transforms of every Object3D, kept in flat arrays indexed by a
+ * transform handle rather than in the objects themselves. Setting a local transform only marks
+ * it dirty; update then walks the transforms parents first, rebuilding the local matrices that
+ * changed and the world matrices of their subtrees, and leaves every other matrix as it was. One
+ * update per frame serves every pass that draws the frame.
+ * Transforms are created, changed and read on the thread owning the scene.
+ */
+class TransformHierarchy {
+private:
+	enum Flags : uint8_t {
+		IN_USE = 1,
+		// the local matrix is out of date, and so is the world matrix of the whole subtree
+		LOCAL_DIRTY = 2,
+	};
+
+	// per transform; the parent is NO_TRANSFORM for roots and free slots
+	std::vector<uint32_t> m_parents;
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::vec3> m_orientations;
+	std::vector<glm::vec3> m_scales;
+	std::vector<glm::vec3> m_centers;
+	std::vector<glm::mat4> m_baseTransforms;
+	std::vector<glm::mat4> m_localMatrices;
+	std::vector<glm::mat4> m_worldMatrices;
+	std::vector<uint8_t> m_flags;
+	// whether update recomputed the transform's world matrix; read by its children in the same update
+	std::vector<uint8_t> m_worldChanged;
+
+	std::vector<uint32_t> m_freeSlots;
+	// every transform in use, each after its parent; rebuilt when a transform is created, freed or re-parented
+	std::vector<uint32_t> m_order;
+	bool m_orderDirty = false;
+	bool m_dirty = false;
+	size_t m_lastRecomputed = 0;
+
+	void markDirty(uint32_t transform);
+	void rebuildOrder();
+
+public:
+	static constexpr uint32_t NO_TRANSFORM = UINT32_MAX;
+
+	TransformHierarchy() = default;
+	TransformHierarchy(const TransformHierarchy&) = delete;
+	TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+	/**
+	 * @brief Gets the hierarchy every Object3D lives in.
+	 */
+	static TransformHierarchy& shared();
+
+	/**
+	 * @brief Creates a root transform at the origin, unrotated and unscaled, reusing a freed slot
+	 * when there is one.
+	 */
+	uint32_t create(const glm::mat4& baseTransform = glm::mat4(1));
+
+	/**
+	 * @brief Frees a transform. Its children have to be freed or given another parent as well.
+	 */
+	void destroy(uint32_t transform);
+
+	/**
+	 * @brief Gives a transform a parent (or none), whose world matrix then applies before its own.
+	 */
+	void setParent(uint32_t transform, uint32_t parent);
+
+	/**
+	 * @brief Copies the local transform of source into transform, keeping transform's parent.
+	 */
+	void copyLocal(uint32_t source, uint32_t transform);
+
+	/**
+	 * @brief Puts transform back at the origin, unrotated and unscaled, keeping its parent.
+	 */
+	void resetLocal(uint32_t transform);
+
+	// Local transform accessors. The local matrix is
+	// translate(position) * translate(center * scale) * rotate(orientation) * scale * translate(-center) * baseTransform,
+	// the rotation applied around z, then x, then y.
+	const glm::vec3& getPosition(uint32_t transform) const { return m_positions[transform]; }
+	const glm::vec3& getOrientation(uint32_t transform) const { return m_orientations[transform]; }
+	const glm::vec3& getScale(uint32_t transform) const { return m_scales[transform]; }
+	const glm::vec3& getCenter(uint32_t transform) const { return m_centers[transform]; }
+	void setPosition(uint32_t transform, const glm::vec3& position);
+	void setOrientation(uint32_t transform, const glm::vec3& orientation);
+	void setScale(uint32_t transform, const glm::vec3& scale);
+	void setCenter(uint32_t transform, const glm::vec3& center);
+
+	/**
+	 * @brief Recomputes the matrices of every transform changed since the last update, and the world
+	 * matrices below them. Does nothing if none changed.
+	 */
+	void update();
+
+	/**
+	 * @brief Gets a transform's local->world matrix, updating the hierarchy first if it changed.
+	 */
+	const glm::mat4& getWorldMatrix(uint32_t transform) {
+		if (m_dirty) {
+			update();
+		}
+		return m_worldMatrices[transform];
+	}
+
+	/**
+	 * @brief Number of transforms in use.
+	 */
+	size_t size() const { return m_parents.size() - m_freeSlots.size(); }
+
+	/**
+	 * @brief Number of world matrices the last update that found changes recomputed.
+	 */
+	size_t getLastRecomputedCount() const { return m_lastRecomputed; }
+};
@@ -0,0 +1,143 @@
+#include "VertexFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <glm/gtc/packing.hpp>
+#include "Mesh3D.h"
+
+static int16_t s_packSnorm16(float value) {
+	return static_cast<int16_t>(std::round(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+void encodeOctahedral(const glm::vec3& vector, int16_t out[2]) {
+	float sum = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+	if (!(sum > 1e-20f) || !std::isfinite(sum)) {
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+	// Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the upper.
+	float x = vector.x / sum;
+	float y = vector.y / sum;
+	if (vector.z < 0.0f) {
+		float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	out[0] = s_packSnorm16(x);
+	out[1] = s_packSnorm16(y);
+}
+
+glm::vec3 decodeOctahedral(const int16_t encoded[2]) {
+	glm::vec3 vector(std::max(encoded[0] / 32767.0f, -1.0f), std::max(encoded[1] / 32767.0f, -1.0f), 0.0f);
+	vector.z = 1.0f - std::abs(vector.x) - std::abs(vector.y);
+	float t = std::max(-vector.z, 0.0f);
+	vector.x += vector.x >= 0.0f ? -t : t;
+	vector.y += vector.y >= 0.0f ? -t : t;
+	return glm::normalize(vector);
+}
+
+VertexLayout chooseVertexLayout(const Vertex3D* vertices, size_t count) {
+	VertexLayout layout = VertexLayout::Static;
+	for (size_t i = 0; i < count; i++) {
+		for (int j = MAX_BONE_PER_VERTEX - 1; j >= 0; j--) {
+			if (vertices[i].m_BoneIDs[j] >= 0 && vertices[i].m_Weights[j] > 0.0f) {
+				if (j >= 4) {
+					return VertexLayout::Skinned8;
+				}
+				layout = VertexLayout::Skinned;
+				break;
+			}
+		}
+	}
+	return layout;
+}
+
+size_t vertexStride(VertexLayout layout) {
+	switch (layout) {
+	case VertexLayout::Skinned:
+		return sizeof(SkinnedVertex);
+	case VertexLayout::Skinned8:
+		return sizeof(SkinnedVertex8);
+	default:
+		return sizeof(StaticVertex);
+	}
+}
+
+/**
+ * @brief Packs the attributes the two layouts share.
+ */
+template <typename PackedVertex>
+static void s_packShared(const Vertex3D& vertex, PackedVertex& out) {
+	out.position = vertex.Position;
+	encodeOctahedral(vertex.Normal, out.normal);
+	encodeOctahedral(vertex.Tangent, out.tangent);
+	out.texCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+	out.texCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+}
+
+/**
+ * @brief Packs as many influences as the vertex has slots for, renormalized over those slots.
+ */
+template <typename PackedVertex>
+static void s_packInfluences(const Vertex3D& vertex, PackedVertex& out) {
+	constexpr int slots = static_cast<int>(sizeof(out.boneIds));
+	static_assert(slots <= MAX_BONE_PER_VERTEX, "packed vertex holds more influences than Vertex3D");
+	float total = 0.0f;
+	for (int j = 0; j < slots; j++) {
+		if (vertex.m_BoneIDs[j] >= 0) {
+			total += std::max(vertex.m_Weights[j], 0.0f);
+		}
+	}
+
+	int sum = 0;
+	int heaviest = 0;
+	for (int j = 0; j < slots; j++) {
+		int bone = vertex.m_BoneIDs[j];
+		float weight = bone >= 0 && total > 0.0f ? std::max(vertex.m_Weights[j], 0.0f) / total : 0.0f;
+		if (bone > 255) {
+			throw std::runtime_error("bone index " + std::to_string(bone) + " does not fit a SkinnedVertex");
+		}
+		// Unused slots point at bone 0 with no weight.
+		out.boneIds[j] = static_cast<uint8_t>(std::max(bone, 0));
+		out.weights[j] = static_cast<uint8_t>(std::round(weight * 255.0f));
+		sum += out.weights[j];
+		if (out.weights[j] > out.weights[heaviest]) {
+			heaviest = j;
+		}
+	}
+	// Give the rounding error to the heaviest influence, so the weights sum to exactly one.
+	if (sum > 0) {
+		out.weights[heaviest] = static_cast<uint8_t>(out.weights[heaviest] + 255 - sum);
+	}
+}
+
+/**
+ * @brief Packs every vertex into a skinned layout.
+ */
+template <typename PackedVertex>
+static void s_packSkinned(const Vertex3D* vertices, size_t count, void* out) {
+	PackedVertex* packed = static_cast<PackedVertex*>(out);
+	for (size_t i = 0; i < count; i++) {
+		s_packShared(vertices[i], packed[i]);
+		s_packInfluences(vertices[i], packed[i]);
+	}
+}
+
+void packVertices(const Vertex3D* vertices, size_t count, VertexLayout layout, void* out) {
+	if (layout == VertexLayout::Static) {
+		StaticVertex* packed = static_cast<StaticVertex*>(out);
+		for (size_t i = 0; i < count; i++) {
+			s_packShared(vertices[i], packed[i]);
+		}
+		return;
+	}
+
+	if (layout == VertexLayout::Skinned8) {
+		s_packSkinned<SkinnedVertex8>(vertices, count, out);
+	}
+	else {
+		s_packSkinned<SkinnedVertex>(vertices, count, out);
+	}
+}
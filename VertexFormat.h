@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+struct Vertex3D;
+
+/**
+ * @brief How a mesh's vertices are stored on the GPU. Vertex3D stays the format meshes are built
+ * and cached in; GeometryPool packs it into one of these when uploading.
+ */
+enum class VertexLayout {
+	// StaticVertex: no skinning data
+	Static,
+	// SkinnedVertex: StaticVertex plus four bone influences
+	Skinned,
+	// SkinnedVertex8: StaticVertex plus eight bone influences, for models imported with eight
+	Skinned8,
+};
+
+/**
+ * @brief A vertex of a mesh without bones, 24 bytes (Vertex3D is 108). Normal and tangent are unit
+ * vectors in octahedral encoding as two snorm16 each; texture coordinates are half floats.
+ */
+struct StaticVertex {
+	glm::vec3 position;
+	int16_t normal[2];
+	int16_t tangent[2];
+	uint16_t texCoords[2];
+};
+
+/**
+ * @brief A vertex of a skinned mesh, 32 bytes: bone indices as uint8 and weights as unorm8 that
+ * sum to exactly 255.
+ */
+struct SkinnedVertex {
+	glm::vec3 position;
+	int16_t normal[2];
+	int16_t tangent[2];
+	uint16_t texCoords[2];
+	uint8_t boneIds[4];
+	uint8_t weights[4];
+};
+
+/**
+ * @brief A vertex of a skinned mesh with up to eight influences, 40 bytes. The first four are
+ * read like SkinnedVertex's, the other four through a second pair of attributes.
+ */
+struct SkinnedVertex8 {
+	glm::vec3 position;
+	int16_t normal[2];
+	int16_t tangent[2];
+	uint16_t texCoords[2];
+	uint8_t boneIds[8];
+	uint8_t weights[8];
+};
+
+/**
+ * @brief Picks Skinned8 if any vertex has more than four bone influences, Skinned if any has one,
+ * Static otherwise.
+ */
+VertexLayout chooseVertexLayout(const Vertex3D* vertices, size_t count);
+
+size_t vertexStride(VertexLayout layout);
+
+/**
+ * @brief Packs count vertices into out, which must hold count * vertexStride(layout) bytes.
+ * Throws if a bone index does not fit in a byte.
+ */
+void packVertices(const Vertex3D* vertices, size_t count, VertexLayout layout, void* out);
+
+/**
+ * @brief Maps a vector to two snorm16 components in octahedral encoding; zero-length or
+ * non-finite vectors (e.g. missing tangents) encode +Z.
+ */
+void encodeOctahedral(const glm::vec3& vector, int16_t out[2]);
+glm::vec3 decodeOctahedral(const int16_t encoded[2]);
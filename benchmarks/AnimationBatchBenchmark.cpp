@@ -0,0 +1,96 @@
+/**
+Headless benchmark of AnimationBatch: a crowd of characters cycling through the bundled rigs
+(coach clapping, goalkeeper, kid idle), each with its own SkeletalAnimator and start time,
+updated at 1, 2, 4, 8 and 16 threads. Reports characters per second and checks that every
+thread count produces the same poses as the single-threaded update.
+Clips are read through SkeletalAnimationLibrary without a model or a GL context (and from the
+asset cache once the game or a previous run has filled it). Build from the repository root with
+the game's include paths, e.g.
+	g++ -O2 -std=c++17 -I. benchmarks/AnimationBatchBenchmark.cpp AssetCache.cpp ThreadPool.cpp -lassimp -pthread -o batch_bench
+and run it from the repository root:
+	./batch_bench [characters] [frames]
+*/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../AnimationBatch.h"
+
+const char* RIG_PATHS[] = {
+	"models/coach/Clapping.dae",
+	"models/goalkeeper/goalkeeper.dae",
+	"models/kid/idle.dae",
+};
+const int THREAD_COUNTS[] = { 1, 2, 4, 8, 16 };
+const float FRAME_TIME = 1.0f / 60.0f;
+
+struct Rig
+{
+	std::unordered_map<std::string, BoneInfo> boneInfoMap;
+	int boneCount = 0;
+	std::unique_ptr<SkeletalAnimationLibrary> clips;
+};
+
+int main(int argc, char** argv)
+{
+	int characters = argc > 1 ? std::atoi(argv[1]) : 4096;
+	int frames = argc > 2 ? std::atoi(argv[2]) : 60;
+
+	std::vector<std::unique_ptr<Rig>> rigs;
+	for (const char* path : RIG_PATHS)
+	{
+		auto rig = std::make_unique<Rig>();
+		rig->clips = std::make_unique<SkeletalAnimationLibrary>(path, rig->boneInfoMap, rig->boneCount);
+		rig->clips->Compress(TrackCompressionSettings());
+		rigs.push_back(std::move(rig));
+	}
+
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> startTime(0.0f, 5.0f);
+	std::vector<float> startTimes(characters);
+	for (auto& time : startTimes)
+		time = startTime(rng);
+
+	std::vector<glm::mat4> reference;
+	for (int threads : THREAD_COUNTS)
+	{
+		// Fresh animators per run, so every thread count replays the same poses.
+		std::vector<std::unique_ptr<SkeletalAnimator>> animators;
+		AnimationBatch batch;
+		for (int i = 0; i < characters; i++)
+		{
+			animators.push_back(std::make_unique<SkeletalAnimator>(&rigs[i % rigs.size()]->clips->GetClip(0)));
+			animators.back()->UpdateAnimation(startTimes[i]);
+			batch.Add(animators.back().get());
+		}
+
+		ThreadPool pool(threads);
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+			batch.Update(pool, FRAME_TIME);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Compare every palette with the single-threaded run.
+		std::vector<glm::mat4> poses;
+		for (auto& animator : animators)
+		{
+			BonePalette palette = animator->GetFinalBoneMatrices();
+			poses.insert(poses.end(), palette.begin(), palette.end());
+		}
+		if (reference.empty())
+			reference = poses;
+		float maxDifference = 0.0f;
+		for (size_t i = 0; i < poses.size(); i++)
+			for (int column = 0; column < 4; column++)
+				for (int row = 0; row < 4; row++)
+					maxDifference = std::fmax(maxDifference, std::fabs(poses[i][column][row] - reference[i][column][row]));
+
+		std::printf("%2d threads: %10.0f characters/s (%d characters x %d frames in %.1f ms), max difference %g\n",
+			threads, characters * static_cast<double>(frames) / seconds, characters, frames, seconds * 1000.0, maxDifference);
+	}
+	std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+	return 0;
+}
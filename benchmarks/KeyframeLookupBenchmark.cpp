@@ -0,0 +1,71 @@
+/**
+Micro-benchmark comparing the cursor/binary-search keyframe lookup in KeyframeLookup.h against
+the linear scan Bone used to do, for tracks of 10, 1k and 100k keys.
+Standalone; build from the repository root with e.g.
+	g++ -O2 -std=c++17 -I. benchmarks/KeyframeLookupBenchmark.cpp -o keyframe_bench
+*/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../KeyframeLookup.h"
+
+// The lookup Bone::GetPositionIndex performed before the cursor was introduced.
+int LinearKeyIndex(const std::vector<float>& timeStamps, float animationTime)
+{
+	for (int index = 0; index < static_cast<int>(timeStamps.size()) - 1; ++index)
+	{
+		if (animationTime < timeStamps[index + 1])
+			return index;
+	}
+	return static_cast<int>(timeStamps.size()) - 2;
+}
+
+template <typename Lookup>
+double NanosecondsPerLookup(const std::vector<float>& times, Lookup lookup)
+{
+	volatile int sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (float time : times)
+		sink = sink + lookup(time);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / times.size();
+}
+
+void RunBenchmark(int keyCount)
+{
+	std::vector<float> keys(keyCount);
+	for (int i = 0; i < keyCount; ++i)
+		keys[i] = static_cast<float>(i);
+	float duration = keys.back();
+
+	// Monotonic playback at roughly a third of a key per frame, looping, and random seeks.
+	const int samples = keyCount > 10000 ? 20000 : 200000;
+	std::vector<float> playback(samples), seeks(samples);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> anyTime(0.0f, duration);
+	float time = 0.0f;
+	for (int i = 0; i < samples; ++i)
+	{
+		time = std::fmod(time + 0.35f, duration);
+		playback[i] = time;
+		seeks[i] = anyTime(rng);
+	}
+
+	for (auto* pattern : { &playback, &seeks })
+	{
+		int cursor = 0;
+		double linear = NanosecondsPerLookup(*pattern, [&](float t) { return LinearKeyIndex(keys, t); });
+		double cached = NanosecondsPerLookup(*pattern, [&](float t) { return FindKeyIndex(keys.data(), keyCount, t, cursor); });
+		std::printf("%7d keys  %-8s  linear %10.1f ns  cursor %6.1f ns  (%.1fx)\n", keyCount,
+			pattern == &playback ? "playback" : "seek", linear, cached, linear / cached);
+	}
+}
+
+int main()
+{
+	for (int keyCount : { 10, 1000, 100000 })
+		RunBenchmark(keyCount);
+	return 0;
+}
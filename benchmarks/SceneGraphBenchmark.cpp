@@ -0,0 +1,199 @@
+/**
+Counts the heap allocations and time it takes to turn each bundled model into a scene graph:
+Skeletal's upload of an imported model (meshes into the GeometryPool, textures through the
+TextureCache, the Object3D hierarchy built from the model's nodes), then handing the hierarchy to
+the scene the way ModelHandle does. Imports come from the asset cache when a previous run or the
+game has filled it. Each model is built twice and the second build is reported, so its textures
+are cache hits and the numbers are the geometry and the hierarchy alone.
+With --synthetic, models of generated geometry with the node counts and the mesh sizes of the
+bundled coach, goalkeeper and ball are measured instead, which needs neither the model files nor
+assimp to import.
+Runs on an offscreen context; build from the repository root with e.g.
+	g++ -O2 -std=c++17 -I. benchmarks/SceneGraphBenchmark.cpp Skeletal.cpp Object3D.cpp TransformHierarchy.cpp Mesh3D.cpp GeometryPool.cpp VertexFormat.cpp MeshOptimizer.cpp RenderQueue.cpp BonePaletteBuffer.cpp ShaderProgram.cpp AssetCache.cpp TextureData.cpp TextureCache.cpp ThreadPool.cpp glad.cpp -lassimp -lsfml-graphics -lsfml-window -lsfml-system -ldl -pthread -o scene_bench
+	LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./scene_bench [--synthetic]
+Adding -DCOPY_HANDOFF hands the hierarchy over by copying it, as ModelHandle did before
+Skeletal::takeRoot. To measure the upload as it was before the scene graph was built by moving
+nodes, copy this file into a checkout of the commit before it was added and build it there
+with -DCOPY_HANDOFF, leaving out TransformHierarchy.cpp (which that tree does not have).
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <SFML/Window/Context.hpp>
+#include "../Skeletal.h"
+
+const char* MODEL_PATHS[] = {
+	"models/coach/Clapping.dae",
+	"models/goalkeeper/goalkeeper.dae",
+	"models/basketball/Basketball.obj",
+	"models/goal/gawang.obj",
+};
+
+struct SyntheticMesh
+{
+	int vertices;
+	int triangles;
+};
+
+struct SyntheticModel
+{
+	const char* name;
+	int nodes;
+	std::vector<SyntheticMesh> meshes;
+};
+
+// the node counts and the meshes' vertex and triangle counts of the bundled models, as imported
+const SyntheticModel SYNTHETIC_MODELS[] = {
+	{ "synthetic coach", 103, { { 52, 76 }, { 97, 152 }, { 80, 116 }, { 7483, 10384 }, { 7483, 10384 } } },
+	{ "synthetic goalkeeper", 77,
+		{ { 538, 898 }, { 684, 1060 }, { 793, 1380 }, { 308, 490 }, { 412, 684 }, { 249, 324 }, { 503, 802 } } },
+	{ "synthetic basketball", 2, { { 547, 960 } } },
+};
+
+std::atomic<size_t> allocations{ 0 };
+std::atomic<size_t> allocatedBytes{ 0 };
+
+void* operator new(size_t size)
+{
+	allocations++;
+	allocatedBytes += size;
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+struct Counts
+{
+	size_t allocations;
+	size_t bytes;
+	double milliseconds;
+};
+
+template <typename Work>
+Counts Measure(Work work)
+{
+	size_t startAllocations = allocations;
+	size_t startBytes = allocatedBytes;
+	auto start = std::chrono::steady_clock::now();
+	work();
+	auto end = std::chrono::steady_clock::now();
+	return Counts{ allocations - startAllocations, allocatedBytes - startBytes,
+		std::chrono::duration<double, std::milli>(end - start).count() };
+}
+
+size_t CountObjects(const Object3D& object)
+{
+	size_t count = 1;
+	for (size_t i = 0; i < object.numberOfChildren(); i++)
+		count += CountObjects(object.getChild(i));
+	return count;
+}
+
+/**
+ * @brief Builds an untextured model shaped like an imported one: a mesh node per mesh under the
+ * root, then a bone chain that branches every fifth node, nodes in depth-first order.
+ */
+ImportedModel BuildSyntheticModel(const SyntheticModel& shape)
+{
+	ImportedModel imported;
+	imported.path = shape.name;
+	ModelData& model = imported.model;
+	for (size_t i = 0; i < shape.meshes.size(); i++)
+	{
+		MeshData mesh;
+		mesh.vertices.resize(shape.meshes[i].vertices, Vertex3D{});
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+			mesh.vertices[v].Position = glm::vec3(static_cast<float>(v), static_cast<float>(i), 0.0f);
+		for (int f = 0; f < 3 * shape.meshes[i].triangles; f++)
+			mesh.faces.push_back(f % (shape.meshes[i].vertices - 2));
+		model.meshes.push_back(std::move(mesh));
+	}
+
+	model.nodes.resize(shape.nodes);
+	for (auto& node : model.nodes)
+		node.transformation = glm::mat4(1);
+	int next = 1;
+	for (int i = 0; i < static_cast<int>(shape.meshes.size()); i++, next++)
+	{
+		model.nodes[0].children.push_back(next);
+		model.nodes[next].meshes.push_back(i);
+	}
+	int parent = 0;
+	while (next < shape.nodes)
+	{
+		model.nodes[parent].children.push_back(next);
+		if (next % 5 == 0 && next + 1 < shape.nodes)
+		{
+			model.nodes[next].children.push_back(next + 1);
+			next += 2;
+			continue;
+		}
+		parent = next;
+		next++;
+	}
+	return imported;
+}
+
+template <typename Import>
+void MeasureModel(const char* name, Import import)
+{
+	// The first build makes the model's textures resident.
+	Skeletal warmUp(import());
+
+	ImportedModel imported = import();
+	std::unique_ptr<Skeletal> model;
+	Counts upload = Measure([&] { model = std::make_unique<Skeletal>(std::move(imported)); });
+
+	Object3D scene(std::vector<Mesh3D>{});
+	size_t objects = CountObjects(model->getRoot());
+#ifdef COPY_HANDOFF
+	Counts handoff = Measure([&] { scene.addChild(Object3D(model->getRoot())); });
+#else
+	Counts handoff = Measure([&] { scene.addChild(model->takeRoot()); });
+#endif
+
+	std::printf("%-36s %8zu | upload: %7zu %12zu %8.2f | handoff: %7zu %10zu\n", name, objects, upload.allocations,
+		upload.bytes, upload.milliseconds, handoff.allocations, handoff.bytes);
+}
+
+int main(int argc, char** argv)
+{
+	bool synthetic = argc > 1 && std::strcmp(argv[1], "--synthetic") == 0;
+
+	sf::Context context(sf::ContextSettings(24, 8, 0, 4, 3), 1, 1);
+	if (!gladLoadGL())
+	{
+		std::printf("could not load OpenGL\n");
+		return 1;
+	}
+
+	std::printf("%-36s %8s | upload: %7s %12s %8s | handoff: %7s %10s\n", "model", "objects", "allocs", "bytes", "ms",
+		"allocs", "bytes");
+	if (synthetic)
+	{
+		for (const SyntheticModel& shape : SYNTHETIC_MODELS)
+			MeasureModel(shape.name, [&] { return BuildSyntheticModel(shape); });
+	}
+	else
+	{
+		for (const char* path : MODEL_PATHS)
+			MeasureModel(path, [&] { return Skeletal::importModel(path, true); });
+	}
+	return 0;
+}
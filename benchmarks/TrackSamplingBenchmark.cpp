@@ -0,0 +1,209 @@
+/**
+Benchmark of AnimationTracks::SampleLocalTransforms against the per-bone sampling Bone used to do
+(AoS keys, one glm::mat4 each for T, R and S, multiplied together).
+By default the rig is generated: 65 bones with a position, rotation and scale key baked on every
+frame at 30 fps. Given a Mixamo COLLADA file, the rig is instead the file's clip, each bone's baked
+matrix keys decomposed into position, rotation and scale keys as Assimp imports them.
+Standalone apart from glm; build from the repository root with the game's flags, e.g.
+	g++ -O2 -std=c++17 -I. benchmarks/TrackSamplingBenchmark.cpp -o track_bench
+	./track_bench ["models/goalkeeper/Goalkeeper Diving Save.dae"]
+*/
+#define GLM_ENABLE_EXPERIMENTAL
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include "../AnimationTracks.h"
+
+const int SYNTHETIC_BONES = 65;
+const int SYNTHETIC_FRAMES = 120;
+const float TICKS_PER_SECOND = 30.0f;
+
+// The per-bone sampling path Bone::GetLocalTransform used before the SoA clip format.
+struct ReferenceBone
+{
+	std::vector<KeyPosition> positions;
+	std::vector<KeyRotation> rotations;
+	std::vector<KeyScale> scales;
+
+	glm::mat4 GetLocalTransform(float time, BoneCursor& cursor) const
+	{
+		int p = FindSegment(positions, time, cursor.position);
+		float pf = GetKeyBlendFactor(positions[p].timeStamp, positions[p + 1].timeStamp, time);
+		glm::mat4 translation = glm::translate(glm::mat4(1.0f),
+			glm::mix(positions[p].position, positions[p + 1].position, pf));
+
+		int r = FindSegment(rotations, time, cursor.rotation);
+		float rf = GetKeyBlendFactor(rotations[r].timeStamp, rotations[r + 1].timeStamp, time);
+		glm::mat4 rotation = glm::toMat4(glm::normalize(
+			glm::slerp(rotations[r].orientation, rotations[r + 1].orientation, rf)));
+
+		int s = FindSegment(scales, time, cursor.scale);
+		float sf = GetKeyBlendFactor(scales[s].timeStamp, scales[s + 1].timeStamp, time);
+		glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::mix(scales[s].scale, scales[s + 1].scale, sf));
+
+		return translation * rotation * scale;
+	}
+
+	// Same cursor walk as FindKeyIndex, over AoS keys.
+	template <typename Key>
+	static int FindSegment(const std::vector<Key>& keys, float time, int& cursor)
+	{
+		int last = static_cast<int>(keys.size()) - 2;
+		if (time >= keys[last + 1].timeStamp)
+			return cursor = last;
+		int index = std::min(std::max(cursor, 0), last);
+		if (keys[index].timeStamp > time)
+			index = 0;
+		while (time >= keys[index + 1].timeStamp)
+			++index;
+		return cursor = index;
+	}
+};
+
+std::vector<ReferenceBone> BuildSyntheticRig()
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<ReferenceBone> bones(SYNTHETIC_BONES);
+	for (ReferenceBone& bone : bones)
+	{
+		glm::quat orientation = glm::normalize(glm::quat(1.0f, unit(rng), unit(rng), unit(rng)));
+		for (int frame = 0; frame < SYNTHETIC_FRAMES; ++frame)
+		{
+			float time = static_cast<float>(frame);
+			glm::quat delta = glm::normalize(glm::quat(1.0f, 0.05f * unit(rng), 0.05f * unit(rng), 0.05f * unit(rng)));
+			orientation = glm::normalize(orientation * delta);
+			bone.positions.push_back({ glm::vec3(unit(rng), unit(rng), unit(rng)), time });
+			bone.rotations.push_back({ orientation, time });
+			bone.scales.push_back({ glm::vec3(1.0f + 0.01f * unit(rng)), time });
+		}
+	}
+	return bones;
+}
+
+// Parses the numbers of the float_array whose id ends with idSuffix, searching from position.
+std::vector<float> ReadFloatArray(const std::string& text, size_t position, const std::string& idSuffix)
+{
+	std::vector<float> values;
+	size_t id = text.find(idSuffix + "\"", position);
+	size_t start = id == std::string::npos ? id : text.find('>', id);
+	if (start == std::string::npos)
+		return values;
+	const char* cursor = text.c_str() + start + 1;
+	const char* end = text.c_str() + text.find('<', start);
+	while (cursor < end)
+	{
+		char* next;
+		float value = std::strtof(cursor, &next);
+		if (next == cursor)
+			break;
+		values.push_back(value);
+		cursor = next;
+	}
+	return values;
+}
+
+/**
+ * @brief Reads the baked matrix animation of every bone of a Mixamo COLLADA file. Times are
+ * converted to frames at 30 fps, the same tick rate as the generated rig.
+ */
+std::vector<ReferenceBone> LoadColladaRig(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	std::vector<ReferenceBone> bones;
+	for (size_t animation = text.find("<animation "); animation != std::string::npos;
+		animation = text.find("<animation ", animation + 1))
+	{
+		std::vector<float> times = ReadFloatArray(text, animation, "-input-array");
+		std::vector<float> matrices = ReadFloatArray(text, animation, "-output-transform-array");
+		if (times.size() < 2 || matrices.size() != 16 * times.size())
+			continue;
+		ReferenceBone bone;
+		for (size_t key = 0; key < times.size(); ++key)
+		{
+			// COLLADA matrices are row-major
+			glm::mat4 matrix;
+			for (int row = 0; row < 4; ++row)
+				for (int column = 0; column < 4; ++column)
+					matrix[column][row] = matrices[16 * key + 4 * row + column];
+			glm::vec3 scale(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])),
+				glm::length(glm::vec3(matrix[2])));
+			glm::mat3 rotation(glm::vec3(matrix[0]) / scale.x, glm::vec3(matrix[1]) / scale.y,
+				glm::vec3(matrix[2]) / scale.z);
+			float time = times[key] * TICKS_PER_SECOND;
+			bone.positions.push_back({ glm::vec3(matrix[3]), time });
+			bone.rotations.push_back({ glm::normalize(glm::quat_cast(rotation)), time });
+			bone.scales.push_back({ scale, time });
+		}
+		bones.push_back(std::move(bone));
+	}
+	return bones;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<ReferenceBone> bones = argc > 1 ? LoadColladaRig(argv[1]) : BuildSyntheticRig();
+	if (bones.empty())
+	{
+		std::printf("no baked bone animation in %s\n", argv[1]);
+		return 1;
+	}
+	int rigBones = static_cast<int>(bones.size());
+	float duration = 0.0f;
+	AnimationTracks tracks;
+	for (int bone = 0; bone < rigBones; ++bone)
+	{
+		const ReferenceBone& ref = bones[bone];
+		tracks.AddTrack("bone" + std::to_string(bone), ref.positions, ref.rotations, ref.scales);
+		duration = std::max(duration, ref.positions.back().timeStamp);
+	}
+
+	const int updates = 200000;
+	std::vector<BoneCursor> referenceCursors(rigBones), trackCursors(rigBones);
+	std::vector<glm::mat4> reference(rigBones), sampled(rigBones);
+	float maxError = 0.0f;
+
+	auto start = std::chrono::steady_clock::now();
+	float time = 0.0f;
+	for (int update = 0; update < updates; ++update)
+	{
+		time = std::fmod(time + TICKS_PER_SECOND / 60.0f, duration);
+		for (int bone = 0; bone < rigBones; ++bone)
+			reference[bone] = bones[bone].GetLocalTransform(time, referenceCursors[bone]);
+	}
+	auto middle = std::chrono::steady_clock::now();
+	time = 0.0f;
+	for (int update = 0; update < updates; ++update)
+	{
+		time = std::fmod(time + TICKS_PER_SECOND / 60.0f, duration);
+		tracks.SampleLocalTransforms(time, trackCursors.data(), sampled.data());
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	for (int bone = 0; bone < rigBones; ++bone)
+		for (int column = 0; column < 4; ++column)
+			for (int row = 0; row < 4; ++row)
+				maxError = std::max(maxError, std::fabs(reference[bone][column][row] - sampled[bone][column][row]));
+
+	double perBone = std::chrono::duration<double, std::micro>(middle - start).count() / updates;
+	double batched = std::chrono::duration<double, std::micro>(end - middle).count() / updates;
+	std::printf("%s, %d-bone rig: per-bone %.2f us/update, batched %.2f us/update (%.1fx), max matrix error %g\n",
+		argc > 1 ? argv[1] : "generated", rigBones, perBone, batched, perBone / batched, maxError);
+#ifdef ANIMATION_TRACKS_SSE
+	std::printf("batched path: SSE, %d tracks per batch\n", AnimationTracks::TRACK_LANES);
+#else
+	std::printf("batched path: scalar fallback\n");
+#endif
+	return 0;
+}
@@ -0,0 +1,178 @@
+/**
+Times the transform work of a frame on a scene shaped like the game's: three animated characters
+of about 100 objects each, plus a few hundred rigid props, of which the characters and the ball
+move every frame. A frame moves them the way main's tick and controls do, then walks the scene
+twice for its model matrices, as the shadow and main passes do. With --static nothing moves, as
+in a paused game or the frames between a menu's updates.
+With --check, times nothing and instead checks every world matrix the hierarchy computes against
+one recomputed recursively from the objects' local transforms, after moving, copying, assigning
+and moving from objects; exits with 1 if any differs.
+Needs no OpenGL context; build from the repository root with e.g.
+	g++ -O2 -std=c++17 -I. benchmarks/TransformBenchmark.cpp Object3D.cpp TransformHierarchy.cpp Mesh3D.cpp GeometryPool.cpp VertexFormat.cpp MeshOptimizer.cpp RenderQueue.cpp BonePaletteBuffer.cpp ShaderProgram.cpp AssetCache.cpp TextureData.cpp TextureCache.cpp ThreadPool.cpp glad.cpp -lsfml-graphics -lsfml-window -lsfml-system -ldl -pthread -o transform_bench
+	./transform_bench [--static | --check]
+*/
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <glm/ext.hpp>
+#include "../Object3D.h"
+
+const int FRAMES = 2000;
+
+Object3D BuildChain(int length)
+{
+	Object3D object(std::vector<Mesh3D>{});
+	object.setPosition(glm::vec3(0, 0.1f, 0));
+	if (length > 1)
+		object.addChild(BuildChain(length - 1));
+	return object;
+}
+
+size_t CountObjects(const Object3D& object)
+{
+	size_t count = 1;
+	for (size_t i = 0; i < object.numberOfChildren(); i++)
+		count += CountObjects(object.getChild(i));
+	return count;
+}
+
+/**
+ * @brief Builds a tree of the given depth, three children to a node, every transform component set.
+ */
+Object3D BuildTree(int depth)
+{
+	Object3D object(std::vector<Mesh3D>{});
+	object.setPosition(glm::vec3(static_cast<float>(depth), 1, 0));
+	object.setOrientation(glm::vec3(0.1f * depth, 0.2f, 0));
+	object.setScale(glm::vec3(1.1f));
+	object.setCenter(glm::vec3(0, 0.5f, 0));
+	if (depth > 0)
+	{
+		for (int i = 0; i < 3; i++)
+			object.addChild(BuildTree(depth - 1));
+	}
+	return object;
+}
+
+struct CheckResult
+{
+	size_t checked = 0;
+	size_t mismatched = 0;
+};
+
+/**
+ * @brief Compares the world matrices of an object and its children with the ones Object3D computed
+ * for itself before the TransformHierarchy.
+ */
+void CheckWorldMatrices(const Object3D& object, const glm::mat4& parent, CheckResult& result)
+{
+	glm::vec3 orientation = object.getOrientation();
+	auto local = glm::translate(glm::mat4(1), object.getPosition());
+	local = glm::translate(local, object.getCenter() * object.getScale());
+	local = glm::rotate(local, orientation[2], glm::vec3(0, 0, 1));
+	local = glm::rotate(local, orientation[0], glm::vec3(1, 0, 0));
+	local = glm::rotate(local, orientation[1], glm::vec3(0, 1, 0));
+	local = glm::scale(local, object.getScale());
+	local = glm::translate(local, -object.getCenter());
+	glm::mat4 world = parent * local;
+
+	const glm::mat4& computed = object.getWorldMatrix();
+	bool matches = true;
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+			matches = matches && std::abs(world[column][row] - computed[column][row]) <= 1e-4f;
+	}
+	result.checked++;
+	if (!matches)
+		result.mismatched++;
+	for (size_t i = 0; i < object.numberOfChildren(); i++)
+		CheckWorldMatrices(object.getChild(i), world, result);
+}
+
+int Check()
+{
+	CheckResult result;
+	Object3D root(std::vector<Mesh3D>{});
+	root.addChild(BuildTree(3));
+	root.addChild(BuildTree(2));
+	CheckWorldMatrices(root, glm::mat4(1), result);
+
+	root.getChild(0).getChild(1).move(glm::vec3(0, 2, 0));
+	CheckWorldMatrices(root, glm::mat4(1), result);
+
+	Object3D copy = root.getChild(0);
+	copy.rotate(glm::vec3(0.3f, 0, 0));
+	CheckWorldMatrices(copy, glm::mat4(1), result);
+
+	root.getChild(1) = BuildTree(1);
+	CheckWorldMatrices(root, glm::mat4(1), result);
+
+	// objects without a transform: made by the default constructor, or moved from
+	Object3D empty;
+	CheckWorldMatrices(empty, glm::mat4(1), result);
+	empty = std::move(copy);
+	CheckWorldMatrices(empty, glm::mat4(1), result);
+	CheckWorldMatrices(copy, glm::mat4(1), result);
+	copy.setPosition(glm::vec3(1, 2, 3));
+	CheckWorldMatrices(copy, glm::mat4(1), result);
+	root.getChild(0) = empty;
+	CheckWorldMatrices(root, glm::mat4(1), result);
+	Object3D moved(std::move(empty));
+	root.getChild(0) = std::move(empty);
+	CheckWorldMatrices(root, glm::mat4(1), result);
+	CheckWorldMatrices(moved, glm::mat4(1), result);
+
+	std::vector<Object3D> objects;
+	for (int i = 0; i < 20; i++)
+		objects.push_back(BuildTree(1));
+	for (auto& object : objects)
+		CheckWorldMatrices(object, glm::mat4(1), result);
+
+	std::printf("%zu world matrices checked, %zu mismatched\n", result.checked, result.mismatched);
+	return result.mismatched == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && std::strcmp(argv[1], "--check") == 0)
+		return Check();
+	bool moving = !(argc > 1 && std::strcmp(argv[1], "--static") == 0);
+
+	Object3D scene(std::vector<Mesh3D>{});
+	// characters: a spine and four limbs of 20 bones each
+	for (int i = 0; i < 3; i++)
+	{
+		Object3D character(std::vector<Mesh3D>{});
+		for (int limb = 0; limb < 5; limb++)
+			character.addChild(BuildChain(20));
+		scene.addChild(std::move(character));
+	}
+	// props: the ball, the goal, the field's decorations
+	for (int i = 0; i < 300; i++)
+		scene.addChild(BuildChain(1));
+
+	std::vector<MeshInstance> instances;
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		for (int i = 0; moving && i < 4; i++)
+		{
+			scene.getChild(i).move(glm::vec3(0.01f, 0, 0));
+			scene.getChild(i).rotate(glm::vec3(0, 0.01f, 0));
+		}
+		for (int pass = 0; pass < 2; pass++)
+		{
+			instances.clear();
+			scene.collectMeshes(instances);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	double total = std::chrono::duration<double, std::micro>(end - start).count();
+
+	std::printf("%zu objects, %d frames%s: %.2f us of transform work per frame\n", CountObjects(scene), FRAMES,
+		moving ? "" : ", nothing moving", total / FRAMES);
+	return 0;
+}
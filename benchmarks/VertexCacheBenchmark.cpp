@@ -0,0 +1,92 @@
+/**
+Reports the vertex cache efficiency (ACMR and ATVR on MeshOptimizer's 16-entry FIFO) of each
+bundled model's meshes at every step of the import: in the order Assimp gives without
+aiProcess_ImproveCacheLocality, in the order it gives with it (as Skeletal imports, its Tipsify pass
+targeting a 12-entry cache), after MeshOptimizer's vertex cache ordering alone, and after the whole
+of optimizeMesh, whose overdraw sort gives back up to 5% of ACMR for outward-facing triangles first.
+Needs no OpenGL context; build from the repository root with e.g.
+	g++ -O2 -std=c++17 -I. benchmarks/VertexCacheBenchmark.cpp MeshOptimizer.cpp -lassimp -o vertex_cache_bench
+	./vertex_cache_bench
+*/
+#include <cstdio>
+#include <vector>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include "../Mesh3D.h"
+#include "../MeshOptimizer.h"
+
+const char* MODEL_PATHS[] = {
+	"models/coach/Clapping.dae",
+	"models/goalkeeper/goalkeeper.dae",
+	"models/basketball/Basketball.obj",
+	"models/goal/gawang.obj",
+};
+
+struct MeshStats
+{
+	VertexCacheStats imported;
+	VertexCacheStats cacheOrdered;
+	VertexCacheStats optimized;
+};
+
+/**
+ * @brief Imports a model with Skeletal's post-processing, optionally without Assimp's cache
+ * locality pass, and measures each mesh's triangles as imported and after MeshOptimizer.
+ */
+bool MeasureModel(const char* path, bool improveCacheLocality, MeshStats& stats)
+{
+	Assimp::Importer importer;
+	auto options = (aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_CalcTangentSpace) & ~aiProcess_LimitBoneWeights;
+	if (!improveCacheLocality)
+		options &= ~aiProcess_ImproveCacheLocality;
+	const aiScene* scene = importer.ReadFile(path, options);
+	if (!scene)
+	{
+		std::printf("%s: %s\n", path, importer.GetErrorString());
+		return false;
+	}
+
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+	{
+		const aiMesh* mesh = scene->mMeshes[m];
+		std::vector<Vertex3D> vertices(mesh->mNumVertices, Vertex3D{});
+		for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+		{
+			vertices[v].Position = glm::vec3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+			vertices[v].Normal = glm::vec3(mesh->mNormals[v].x, mesh->mNormals[v].y, mesh->mNormals[v].z);
+		}
+		std::vector<uint32_t> indices;
+		for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+		{
+			if (mesh->mFaces[f].mNumIndices != 3)
+				continue;
+			indices.insert(indices.end(), mesh->mFaces[f].mIndices, mesh->mFaces[f].mIndices + 3);
+		}
+
+		stats.imported += analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		std::vector<uint32_t> cacheOrdered = indices;
+		optimizeVertexCache(cacheOrdered.data(), cacheOrdered.size(), vertices.size());
+		stats.cacheOrdered += analyzeVertexCache(cacheOrdered.data(), cacheOrdered.size(), vertices.size());
+		optimizeMesh(vertices, indices);
+		stats.optimized += analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	}
+	return true;
+}
+
+int main()
+{
+	std::printf("%-34s %6s | %6s %6s %6s %6s\n", "model", "", "plain", "assimp", "cache", "mesh");
+	for (const char* path : MODEL_PATHS)
+	{
+		MeshStats plain;
+		MeshStats improved;
+		if (!MeasureModel(path, false, plain) || !MeasureModel(path, true, improved))
+			continue;
+		std::printf("%-34s %6s | %6.3f %6.3f %6.3f %6.3f\n", path, "ACMR", plain.imported.acmr(), improved.imported.acmr(),
+			improved.cacheOrdered.acmr(), improved.optimized.acmr());
+		std::printf("%-34s %6s | %6.3f %6.3f %6.3f %6.3f\n", "", "ATVR", plain.imported.atvr(), improved.imported.atvr(),
+			improved.cacheOrdered.atvr(), improved.optimized.atvr());
+	}
+	return 0;
+}
@@ -7,12 +7,19 @@ This application renders a textured mesh that was loaded with Assimp.
 #include <memory>
 #include <glad/glad.h>
 
+#include "AnimationBatch.h"
+#include "AssetLoader.h"
 #include "Mesh3D.h"
 #include "Object3D.h"
 #include "Animator.h"
 #include "RotationAnimation.h"
+#include "IndirectBatch.h"
+#include "RenderQueue.h"
 #include "ShaderProgram.h"
+#include "TextureCache.h"
+#include "TransformHierarchy.h"
 
+#include "BonePaletteBuffer.h"
 #include "Skeletal.h"
 #include <algorithm>
 #include <Skeletal.h>
@@ -98,12 +105,10 @@ ShaderProgram shadowMapShader() {
 }
 
 /**
- * @brief Loads an image from the given path into an OpenGL texture.
+ * @brief Loads an image from the given path into an OpenGL texture, or shares the one already loaded.
  */
 Texture loadTexture(const std::filesystem::path& path, const std::string& samplerName = "baseTexture") {
-	sf::Image i;
-	i.loadFromFile(path.string());
-	return Texture::loadImage(i, samplerName);
+	return TextureCache::shared().load(path.string(), samplerName);
 }
 
 // Shadow
@@ -157,15 +162,6 @@ void setUpLight(ShaderProgram& program) {
 	//program.setUniform("light_quadratic", 0.0032f);
 }
 
-void renderSkeletal(sf::RenderWindow& window, ShaderProgram& program, Object3D& obj, std::vector<glm::mat4>& transforms) {
-	program.activate();
-	program.setUniform("skeletal", true);
-	for (int i = 0; i < transforms.size(); ++i)
-		program.setUniform("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
-	obj.render(window, program);
-	program.setUniform("skeletal", false);
-}
-
 Scene lightScene() {
 	Texture tmp_texture;
 	auto mesh = Mesh3D::cube(tmp_texture);
@@ -272,6 +268,19 @@ bool isCollideBallWall(Circle& circle, const Wall& wall) {
 
 // Object3D is same as Object3D, except Object3D has bones array for skeletal animation.
 int main() {
+	// Measures asset loading up to the first frame; compare a cold start with a warm asset cache.
+	sf::Clock startup;
+	bool first_frame = true;
+
+	// Start loading the models right away: they are imported and decoded on worker threads while
+	// the window, shaders and scenery are set up, and boxes stand in for them until they arrive.
+	AssetLoader loader;
+	ModelHandle& coach_asset = loader.loadModel("models/coach/Clapping.dae", true, { "models/coach/Clapping.dae" });
+	ModelHandle& goalkeeper_asset = loader.loadModel("models/goalkeeper/goalkeeper.dae", true,
+		{ "models/goalkeeper/goalkeeper.dae" });
+	ModelHandle& ball_asset = loader.loadModel("models/basketball/Basketball.obj", true);
+	ModelHandle& goal_asset = loader.loadModel("models/goal/gawang.obj", true);
+
 	// Initialize the window and OpenGL.
 	sf::ContextSettings Settings;
 	Settings.depthBits = 24; // Request a 24 bits depth buffer
@@ -283,47 +292,46 @@ int main() {
 
 	// shadow set up 
 	auto shadow_shader = setUpShadow();
+	UniformHandle shadow_matrices[6];
+	for (int i = 0; i < 6; ++i)
+		shadow_matrices[i] = shadow_shader.getUniformHandle("shadowMatrices[" + std::to_string(i) + "]");
 
 	// main shader set up
 
 	ShaderProgram skeletal_shader = skeletalShader();
 
+	// bone palettes of the coach and goalkeeper
+	BonePaletteBuffer bone_palettes(2);
+	RenderQueue render_queue;
+
 	auto perspective = glm::perspective(glm::radians(45.0), static_cast<double>(window.getSize().x) / window.getSize().y, 0.1, 100.0);
 	skeletal_shader.activate();
 	skeletal_shader.setUniform("projection", perspective);
 
 	setUpLight(skeletal_shader);
 
+	// The characters' animators are created once their models and clips are loaded, and are
+	// updated together, on a pool of their own so loading work does not hold them up.
+	ThreadPool animation_pool;
+	AnimationBatch animation_batch;
 	// coach clapping 
-	Skeletal coach_model("models/coach/Clapping.dae", true);
+	std::unique_ptr<SkeletalAnimator> coach_animator;
 
-	SkeletalAnimation coach_clap("models/coach/Clapping.dae", &coach_model);
-	SkeletalAnimator coach_animator(&coach_clap);
-
-	auto& coach = coach_model.getRoot();
+	auto& coach = coach_asset.getRoot();
 	coach.grow(glm::vec3(1.2, 1.2, 1.2));
 	coach.move(glm::vec3(3, 0, -5));
 
 	// goalkeeper 
-	Skeletal goalkeeper_model("models/goalkeeper/goalkeeper.dae", true);
-
-	SkeletalAnimation goalkeeper_stand("models/goalkeeper/goalkeeper.dae", &goalkeeper_model);
-	SkeletalAnimator goalkeeper_animator(&goalkeeper_stand);
+	std::unique_ptr<SkeletalAnimator> goalkeeper_animator;
 
-	auto& goalkeeper = goalkeeper_model.getRoot();
+	auto& goalkeeper = goalkeeper_asset.getRoot();
 	goalkeeper.grow(glm::vec3(1.2, 1.2, 1.2));
 	goalkeeper.move(glm::vec3(0, 0, -6));
 
 	// kid 
-	Skeletal kid_model("models/kid/kid.dae", true);
-
-	SkeletalAnimation kid_wave("models/kid/kid.dae", &kid_model);
-	SkeletalAnimator kid_animator(&kid_wave);
-
-	SkeletalAnimation idle_animation("models/kid/idle.dae", &kid_model);
-	SkeletalAnimator idle_animator(&idle_animation);
-
-	auto& kid = kid_model.getRoot();
+	// The kid's model is not in the repository (models/kid holds only its idle clip), so the kid
+	// is drawn as a box.
+	Object3D kid;
 	//kid.move(glm::vec3(0, 0, 0));
 	float_t kid_scale = 1.0;
 	kid.grow(glm::vec3(kid_scale, kid_scale, kid_scale));
@@ -378,6 +386,21 @@ int main() {
 		Wall(textures, glm::vec3(0, 5, 10), glm::vec3(0, PI, 0), 30.0f, 15.0f),
 	};
 
+	// Boxes of the given size, sitting on their model's origin, stand in for the models still loading.
+	auto placeholder = [&textures](const glm::vec3& size) {
+		auto box = Object3D(std::vector<Mesh3D>{Mesh3D::cube(textures[0])});
+		box.grow(size * 0.5f);
+		box.move(glm::vec3(0, size.y * 0.5f, 0));
+		return box;
+	};
+	kid.addChild(placeholder(glm::vec3(0.6, 1.8, 0.6)));
+	coach_asset.setPlaceholder(placeholder(glm::vec3(0.5, 1.5, 0.5)));
+	goalkeeper_asset.setPlaceholder(placeholder(glm::vec3(0.5, 1.5, 0.5)));
+	goal_asset.setPlaceholder(placeholder(glm::vec3(3, 2, 0.2)));
+	auto ball_placeholder = placeholder(glm::vec3(1, 1, 1));
+	ball_placeholder.move(glm::vec3(0, -0.5, 0));
+	ball_asset.setPlaceholder(std::move(ball_placeholder));
+
 	auto ceiling = Object3D(std::vector<Mesh3D>{Mesh3D::square(textures)});
 	ceiling.rotate(glm::vec3(PI / 2, 0, 0));
 	ceiling.grow(glm::vec3(30, 30, 30));
@@ -385,20 +408,30 @@ int main() {
 
 	// ---------------------------------------------------------------------------------------------------------------
 
-	auto ball = Skeletal("models/basketball/Basketball.obj", true).getRoot();
+	auto& ball = ball_asset.getRoot();
 	float_t ball_radius = 0.01;
 	float_t mass = 1;	
 	ball.setMass(mass);
 	ball.grow(glm::vec3(0.2, 0.2, 0.2));
 	ball.move(glm::vec3(0, 2, -3));
 
-	auto goal = Skeletal("models/goal/gawang.obj", true).getRoot();
+	auto& goal = goal_asset.getRoot();
 	float_t goal_radius = 0.3;
 	float_t mass2 = 1;
 	goal.setMass(mass2);
 	goal.grow(glm::vec3(1, 1, 1));
 	goal.move(glm::vec3(0, 0, -8));
 
+	// the scenery, drawn with one indirect draw per texture set (per pool block in the shadow pass)
+	IndirectBatch static_scene;
+	static_scene.add(ground);
+	static_scene.add(ceiling);
+	static_scene.add(ball);
+	static_scene.add(goal);
+	for (auto& wall : walls) {
+		static_scene.add(wall.wall_object);
+	}
+
 	// light source
 	auto light_scene = lightScene();
 	auto light_cube = light_scene.objects[0];
@@ -485,6 +518,24 @@ int main() {
 			}
 		}
 
+		// Upload the models that finished loading, and animate the characters among them.
+		if (loader.getPendingCount() > 0 && loader.update() > 0) {
+			if (coach_asset.isReady() && !coach_animator) {
+				coach_animator = std::make_unique<SkeletalAnimator>(&coach_asset.getClips(0).GetClip(0));
+				animation_batch.Add(coach_animator.get());
+			}
+			if (goalkeeper_asset.isReady() && !goalkeeper_animator) {
+				goalkeeper_animator = std::make_unique<SkeletalAnimator>(&goalkeeper_asset.getClips(0).GetClip(0));
+				animation_batch.Add(goalkeeper_animator.get());
+			}
+			if (loader.getPendingCount() == 0) {
+				TextureCacheStats texture_stats = TextureCache::shared().getStats();
+				std::cout << "Textures: " << texture_stats.residentTextures << " resident in "
+					<< texture_stats.residentBytes / 1024 << " KB, " << texture_stats.hits << " hits and "
+					<< texture_stats.misses << " misses\n";
+			}
+		}
+
 		auto now = c.getElapsedTime();
 		auto diff = now - last;
 		auto diffSeconds = diff.asSeconds();
@@ -555,15 +606,6 @@ int main() {
 		else {
 			moving = true;
 		}
-		std::vector <glm::mat4> kid_transforms;
-		if (moving && kid.getPosition().y == 0) {
-			kid_animator.UpdateAnimation(diff.asSeconds());
-			kid_transforms = kid_animator.GetFinalBoneMatrices();
-		}
-		else {
-			idle_animator.UpdateAnimation(diff.asSeconds());
-			kid_transforms = idle_animator.GetFinalBoneMatrices();
-		}
 
 		glm::vec3 forward_cam = target - camera_pos;
 		forward_cam.y = 0;
@@ -686,11 +728,26 @@ int main() {
 
 		//std::cout << ground.getPosition() << "\n";
 
-		coach_animator.UpdateAnimation(diffSeconds);
-		auto coach_transforms = coach_animator.GetFinalBoneMatrices();
+		animation_batch.Update(animation_pool, diffSeconds);
+		BonePalette coach_transforms{ nullptr, 0 };
+		if (coach_animator) {
+			coach_transforms = coach_animator->GetFinalBoneMatrices();
+		}
+
+		BonePalette goalkeeper_transforms{ nullptr, 0 };
+		if (goalkeeper_animator) {
+			goalkeeper_transforms = goalkeeper_animator->GetFinalBoneMatrices();
+		}
 
-		goalkeeper_animator.UpdateAnimation(diffSeconds);
-		auto goalkeeper_transforms = goalkeeper_animator.GetFinalBoneMatrices();
+		// upload each palette once; the shadow and main passes bind the same range
+		bone_palettes.beginFrame();
+		size_t coach_palette = bone_palettes.upload(coach_transforms.matrices, coach_transforms.size());
+		size_t goalkeeper_palette = bone_palettes.upload(goalkeeper_transforms.matrices, goalkeeper_transforms.size());
+		// world matrices of everything that moved this frame, read by both passes
+		TransformHierarchy& transforms = TransformHierarchy::shared();
+		transforms.update();
+		// likewise the scenery's model matrices (the ball moves)
+		static_scene.update();
 
 		// render to create depth map (shadow map)
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -700,6 +757,7 @@ int main() {
 		float far_plane = 100.0f;
 		//glm::mat4 shadowProj = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
 		glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT, near_plane, far_plane);
+
 		std::vector<glm::mat4> shadowTransforms;
 		auto lightPos = light_cube.getPosition();
 		shadowTransforms.push_back(shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)));
@@ -714,22 +772,19 @@ int main() {
 		glClear(GL_DEPTH_BUFFER_BIT);
 		shadow_shader.activate();
 		for (unsigned int i = 0; i < 6; ++i)
-			shadow_shader.setUniform("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+			shadow_shader.setUniform(shadow_matrices[i], shadowTransforms[i]);
 		shadow_shader.setUniform("far_plane", far_plane);
 		shadow_shader.setUniform("lightPos", lightPos);
 
-		renderSkeletal(window, shadow_shader, kid, kid_transforms);
-		renderSkeletal(window, shadow_shader, coach, coach_transforms);
-		renderSkeletal(window, shadow_shader, goalkeeper, goalkeeper_transforms);
-
-		ground.render(window, shadow_shader);
-		ceiling.render(window, shadow_shader);
-		ball.render(window, shadow_shader);
-		goal.render(window, shadow_shader);
+		// Placeholders have no bones: they are drawn without a palette.
+		kid.submit(render_queue, shadow_shader);
+		coach.submit(render_queue, shadow_shader, coach_animator ? &bone_palettes : nullptr, coach_palette);
+		goalkeeper.submit(render_queue, shadow_shader, goalkeeper_animator ? &bone_palettes : nullptr, goalkeeper_palette);
 
-		for (auto& wall : walls) {
-			wall.wall_object.render(window, shadow_shader);
-		}
+		static_scene.draw(shadow_shader, false);
+		RenderQueueStats frame_stats = static_scene.getStats();
+		render_queue.flush();
+		frame_stats += render_queue.getStats();
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -747,29 +802,45 @@ int main() {
 		glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
 		skeletal_shader.setUniform("depthMap", 4);
 
-		renderSkeletal(window, skeletal_shader, kid, kid_transforms);
-		renderSkeletal(window, skeletal_shader, coach, coach_transforms);
-		renderSkeletal(window, skeletal_shader, goalkeeper, goalkeeper_transforms);
+		kid.submit(render_queue, skeletal_shader);
+		coach.submit(render_queue, skeletal_shader, coach_animator ? &bone_palettes : nullptr, coach_palette);
+		goalkeeper.submit(render_queue, skeletal_shader, goalkeeper_animator ? &bone_palettes : nullptr, goalkeeper_palette);
 
-		ground.render(window, skeletal_shader);
-		ceiling.render(window, skeletal_shader);
-		ball.render(window, skeletal_shader);
-		goal.render(window, skeletal_shader);
-
-		for (auto& wall : walls) {
-			wall.wall_object.render(window, skeletal_shader);
-		}
+		static_scene.draw(skeletal_shader, true);
+		frame_stats += static_scene.getStats();
 
 		// light cube render
 		light_shader.activate();
 		light_shader.setUniform("view", camera);
 		for (auto& o : light_scene.objects) {
-			o.render(window, light_shader);
+			o.submit(render_queue, light_shader);
 		}
+		render_queue.flush();
+		frame_stats += render_queue.getStats();
 
 		glDepthFunc(GL_LESS);
 
+		bone_palettes.endFrame();
 		window.display();
+		if (first_frame) {
+			std::cout << "Startup time to first frame: " << startup.getElapsedTime().asMilliseconds() << " ms, with "
+				<< loader.getPendingCount() << " models still loading\n";
+			std::cout << "First frame: " << frame_stats.draws << " draws, "
+				<< frame_stats.stateChanges() << " state changes, "
+				<< frame_stats.uniformUploads << " uniform uploads, the scenery's "
+				<< static_scene.getDrawCount() << " meshes per pass included"
+				<< (static_scene.usesMultiDraw() ? " with multi-draw indirect\n" : " drawn one by one\n");
+			const GeometryPool& geometry = GeometryPool::shared();
+			std::cout << "Vertex data: " << geometry.getVertexCount(VertexLayout::Static) << " static and "
+				<< geometry.getVertexCount(VertexLayout::Skinned) + geometry.getVertexCount(VertexLayout::Skinned8)
+				<< " skinned vertices in "
+				<< geometry.getVertexBytes() / 1024 << " KB (" << geometry.getUnpackedVertexBytes() / 1024 << " KB as Vertex3D), "
+				<< geometry.getIndexBytes() / 1024 << " KB of indices, 16-bit for " << geometry.getShortIndexMeshCount()
+				<< " of " << geometry.getMeshCount() << " meshes\n";
+			std::cout << "Transforms: " << transforms.size() << " objects, "
+				<< transforms.getLastRecomputedCount() << " world matrices computed\n";
+			first_frame = false;
+		}
 	}
 
 	return 0;
@@ -2,10 +2,10 @@
 // A vertex shader for rendering vertices with normal vectors and texture coordinates,
 // which creates outputs needed for a Phong reflection fragment shader.
 layout (location=0) in vec3 vPosition;
-layout (location=1) in vec3 vNormal;
+layout (location=1) in vec2 vNormal;
 layout (location=2) in vec2 vTexCoord;
 
-layout (location = 3) in vec3 vTangent;
+layout (location = 3) in vec2 vTangent;
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -18,11 +18,20 @@ out vec3 FragWorldPos;
 // add: TBN
 out mat3 TBN;
 
+// Normals and tangents arrive octahedral-encoded (see VertexFormat.h).
+vec3 octDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+
 void main() {
     // Transform the position to clip space.
     gl_Position = projection * view * model * vec4(vPosition, 1.0);
     TexCoord = vTexCoord;
-    Normal = mat3(transpose(inverse(model))) * vNormal;
+    vec3 normal = octDecode(vNormal);
+    Normal = mat3(transpose(inverse(model))) * normal;
     
     // TODO: transform the vertex position into world space, and assign it 
     // to FragWorldPos.
@@ -30,8 +39,8 @@ void main() {
 
     // add: TBN
     mat3 normalMatrix = mat3(transpose(inverse(model)));
-    vec3 N = normalize(normalMatrix * vNormal);
-    vec3 T = normalize(normalMatrix * vTangent);
+    vec3 N = normalize(normalMatrix * normal);
+    vec3 T = normalize(normalMatrix * octDecode(vTangent));
     vec3 B = normalize(cross(N, T));
     TBN = mat3(T, B, N);
 }
\ No newline at end of file
@@ -13,8 +13,11 @@ in mat3 TBN;
 
 // Uniforms: MUST BE PROVIDED BY THE APPLICATION.
 
-// The mesh's base (diffuse) texture.
+// The mesh's base (diffuse) texture; or, when baseTextureLayer is not -1, that layer of
+// baseTextureArray, which holds the base textures of a whole model.
 uniform sampler2D baseTexture;
+uniform sampler2DArray baseTextureArray;
+uniform int baseTextureLayer;
 uniform sampler2D specularMap;
 uniform sampler2D normalMap;
 
@@ -96,8 +99,9 @@ void main() {
     vec3 norm = vec3(0);
 
     if (hasNormalMap) {
-        norm = vec3(texture(normalMap, TexCoord));
-        norm = normalize(norm * 2.0 - 1.0); 
+        // normal maps are stored as BC5, x and y only; z is the positive root
+        vec2 xy = texture(normalMap, TexCoord).rg * 2.0 - 1.0;
+        norm = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
         norm = normalize(TBN * norm);
     }
     else {
@@ -128,8 +132,12 @@ void main() {
         }
     }
 
+    vec4 baseColor = baseTextureLayer >= 0
+        ? texture(baseTextureArray, vec3(TexCoord, baseTextureLayer))
+        : texture(baseTexture, TexCoord);
+
     float shadow = ShadowCalculation(norm, lightDir);
     // shadow = 0;
     FragColor = vec4(ambientIntensity * attenuation + (1.0 - shadow) * (diffuseIntensity + specularIntensity) * attenuation, 1) 
-        * texture(baseTexture, TexCoord); 
+        * baseColor; 
 }
\ No newline at end of file
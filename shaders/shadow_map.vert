@@ -1,31 +1,46 @@
 #version 430 core
 
 layout (location = 0) in vec3 vPosition;
-layout (location = 1) in vec3 vNormal;
+layout (location = 1) in vec2 vNormal;
 layout (location = 2) in vec2 vTexCoord;
-layout (location = 3) in vec3 vTangent;
-layout(location = 4) in ivec4 boneIds; 
+layout (location = 3) in vec2 vTangent;
+layout(location = 4) in uvec4 boneIds;
 layout(location = 5) in vec4 weights;
+// influences five to eight, from SkinnedVertex8; weightsHigh is zero for other vertices
+layout(location = 10) in uvec4 boneIdsHigh;
+layout(location = 11) in vec4 weightsHigh;
+// per-draw model matrix of an IndirectBatch, read instead of model when indirect is set
+layout(location = 6) in mat4 drawModel;
 	
 uniform mat4 model;
+uniform bool indirect;
 // uniform mat4 lightSpaceMatrix;
 uniform bool skeletal;
 
 const int MAX_BONES = 100;
-const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+const int MAX_BONE_INFLUENCE = 8;
+// one character's palette, bound from BonePaletteBuffer (BONE_PALETTE_BINDING)
+layout(std140, binding = 0) uniform BonePalette {
+    mat4 finalBonesMatrices[MAX_BONES];
+};
 
 void main()
 {
+    mat4 modelMatrix = indirect ? drawModel : model;
     if (!skeletal) {
-        gl_Position = model * vec4(vPosition, 1.0);
+        gl_Position = modelMatrix * vec4(vPosition, 1.0);
     }
     else {
+        // Influences are sorted by decreasing weight, so the first zero weight ends them.
         mat4 boneTransform = finalBonesMatrices[boneIds[0]] * weights[0];
-        boneTransform += finalBonesMatrices[boneIds[1]] * weights[1];
-        boneTransform += finalBonesMatrices[boneIds[2]] * weights[2];
-        boneTransform += finalBonesMatrices[boneIds[3]] * weights[3];
+        for (int i = 1; i < MAX_BONE_INFLUENCE; i++) {
+            float weight = i < 4 ? weights[i] : weightsHigh[i - 4];
+            if (weight == 0.0) {
+                break;
+            }
+            boneTransform += finalBonesMatrices[i < 4 ? boneIds[i] : boneIdsHigh[i - 4]] * weight;
+        }
 
-        gl_Position = model * boneTransform * vec4(vPosition, 1.0);
+        gl_Position = modelMatrix * boneTransform * vec4(vPosition, 1.0);
     }
 }
\ No newline at end of file
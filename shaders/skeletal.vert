@@ -1,15 +1,21 @@
 #version 430 core
 
 layout (location = 0) in vec3 vPosition;
-layout (location = 1) in vec3 vNormal;
+layout (location = 1) in vec2 vNormal;
 layout (location = 2) in vec2 vTexCoord;
-layout (location = 3) in vec3 vTangent;
-layout(location = 4) in ivec4 boneIds; 
+layout (location = 3) in vec2 vTangent;
+layout(location = 4) in uvec4 boneIds;
 layout(location = 5) in vec4 weights;
+// influences five to eight, from SkinnedVertex8; weightsHigh is zero for other vertices
+layout(location = 10) in uvec4 boneIdsHigh;
+layout(location = 11) in vec4 weightsHigh;
+// per-draw model matrix of an IndirectBatch, read instead of model when indirect is set
+layout(location = 6) in mat4 drawModel;
 	
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+uniform bool indirect;
 
 out vec2 TexCoord;
 out vec3 Normal;
@@ -19,38 +25,56 @@ out mat3 TBN;
 
 // skeletal animation
 const int MAX_BONES = 100;
-const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+const int MAX_BONE_INFLUENCE = 8;
+// one character's palette, bound from BonePaletteBuffer (BONE_PALETTE_BINDING)
+layout(std140, binding = 0) uniform BonePalette {
+    mat4 finalBonesMatrices[MAX_BONES];
+};
 uniform bool skeletal;
 
 // shadow
 // uniform mat4 lightSpaceMatrix;
 // out vec4 FragPosLightSpace;
 
+// Normals and tangents arrive octahedral-encoded (see VertexFormat.h).
+vec3 octDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+
 void main()
 {
+    mat4 modelMatrix = indirect ? drawModel : model;
     vec4 totalPosition;
     if (!skeletal) {
         totalPosition = vec4(vPosition, 1.0);
     }
     else {
+        // Influences are sorted by decreasing weight, so the first zero weight ends them.
         mat4 boneTransform = finalBonesMatrices[boneIds[0]] * weights[0];
-        boneTransform += finalBonesMatrices[boneIds[1]] * weights[1];
-        boneTransform += finalBonesMatrices[boneIds[2]] * weights[2];
-        boneTransform += finalBonesMatrices[boneIds[3]] * weights[3];
+        for (int i = 1; i < MAX_BONE_INFLUENCE; i++) {
+            float weight = i < 4 ? weights[i] : weightsHigh[i - 4];
+            if (weight == 0.0) {
+                break;
+            }
+            boneTransform += finalBonesMatrices[i < 4 ? boneIds[i] : boneIdsHigh[i - 4]] * weight;
+        }
 
         totalPosition = boneTransform * vec4(vPosition, 1.0);
     }
 		
-    gl_Position =  projection * view * model * totalPosition;
+    gl_Position =  projection * view * modelMatrix * totalPosition;
     TexCoord = vTexCoord;
 
-    Normal = mat3(transpose(inverse(model))) * vNormal;
+    vec3 normal = octDecode(vNormal);
+    Normal = mat3(transpose(inverse(modelMatrix))) * normal;
 
-    FragWorldPos = vec3(model * totalPosition);
-    mat3 normalMatrix = mat3(transpose(inverse(model)));
-    vec3 N = normalize(normalMatrix * vNormal);
-    vec3 T = normalize(normalMatrix * vTangent);
+    FragWorldPos = vec3(modelMatrix * totalPosition);
+    mat3 normalMatrix = mat3(transpose(inverse(modelMatrix)));
+    vec3 N = normalize(normalMatrix * normal);
+    vec3 T = normalize(normalMatrix * octDecode(vTangent));
     vec3 B = normalize(cross(N, T));
     TBN = mat3(T, B, N);
 }
\ No newline at end of file
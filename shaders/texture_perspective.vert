@@ -1,7 +1,7 @@
 #version 330
 // A vertex shader for perspective viewing of a mesh with normal vectors and texture coordinates.
 layout (location=0) in vec3 vPosition;
-layout (location=1) in vec3 vNormal;
+layout (location=1) in vec2 vNormal;
 layout (location=2) in vec2 vTexCoord;
 
 uniform mat4 projection;
@@ -11,6 +11,14 @@ uniform mat4 model;
 out vec2 TexCoord;
 out vec3 Normal;
 
+// Normals and tangents arrive octahedral-encoded (see VertexFormat.h).
+vec3 octDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+
 void main() {
     // Transform the position to clip space.
     gl_Position = projection * view * model * vec4(vPosition, 1.0);
@@ -18,5 +26,5 @@ void main() {
 
     // Transform the vertex normal to world space using the normal matrix.
     mat4 normalMatrix = transpose(inverse(model));
-    Normal = mat3(normalMatrix) * vNormal;
+    Normal = mat3(normalMatrix) * octDecode(vNormal);
 }
\ No newline at end of file